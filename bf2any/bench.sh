@@ -0,0 +1,158 @@
+#!/bin/sh
+# Benchmark the bf2any runners; every program in ../testing that has a .out
+# file is run by each runner that has been built, using the .in file as
+# input. These translate and run in one go so only the whole time of each
+# run is measured; the median, minimum and maximum of the repeats are
+# written to bench.csv and bench.json in the same layout as tritium's.
+#
+# The programs with a .opt file need tritium's options and are skipped.
+#
+# Usage: bench.sh [-n repeats] [-t timeout] [-e "runners"] [-o name] [programs]
+#
+# The runners are: run jit crun crun-ldl
+
+TESTDIR=${TESTDIR:-../testing}
+REPS=5
+TIMEOUT=120
+ENGINES="run jit crun crun-ldl"
+NAME=bench
+
+while [ $# -gt 0 ]
+do
+    case "$1" in
+    -n) REPS="$2"; shift 2;;
+    -t) TIMEOUT="$2"; shift 2;;
+    -e) ENGINES="$2"; shift 2;;
+    -o) NAME="$2"; shift 2;;
+    -*) echo >&2 "Usage: $0 [-n repeats] [-t timeout] [-e runners] [-o name] [programs]"
+	exit 1;;
+    *) break;;
+    esac
+done
+
+PROGS="$*"
+[ "$PROGS" = "" ] && {
+    for f in "$TESTDIR"/*.out
+    do [ -f "${f%.out}.b" -a ! -f "${f%.out}.opt" ] &&
+	PROGS="$PROGS `basename "${f%.out}"`"
+    done
+}
+
+TMP="${TMPDIR:-/tmp}/bench.$$"
+mkdir "$TMP" || exit 1
+trap 'rm -rf "$TMP"' 0
+trap 'exit 1' 1 2 15
+
+TO=
+[ "`which timeout 2>/dev/null`" != "" ] && TO="timeout $TIMEOUT"
+
+runner() {
+    case "$1" in
+    run)	CMD="./bf2run";;
+    jit)	CMD="./bf2jit";;
+    crun)	CMD="./bf2crun";;
+    crun-ldl)	CMD="./bf2crun -ldl";;
+    *) return 1;;
+    esac
+}
+
+# GNU date has nanoseconds, without it the times are whole seconds.
+now() {
+    T=`date +%s.%N`
+    case "$T" in
+    *N) date +%s;;
+    *) echo "$T";;
+    esac
+}
+
+stats() {
+    sort -g | awk '
+	{ v[NR] = $1 }
+	END {
+	    if (NR == 0) { print "0 0 0"; exit }
+	    if (NR % 2) m = v[(NR+1)/2]; else m = (v[NR/2] + v[NR/2+1]) / 2
+	    printf "%.6f %.6f %.6f\n", m, v[1], v[NR]
+	}'
+}
+
+available() {
+    runner "$1" || return 1
+    set -- $CMD
+    [ -x "$1" ] || return 1
+    echo A > "$TMP/in"
+    echo ',+.' > "$TMP/probe.b"
+    { X=`$TO $CMD "$TMP/probe.b" < "$TMP/in"`; } 2>/dev/null
+    [ "$X" = B ]
+}
+
+ENGLIST=
+for e in $ENGINES
+do
+    if available $e
+    then ENGLIST="$ENGLIST $e"
+    else echo >&2 "Runner $e is not available"
+    fi
+done
+
+CSV="$NAME.csv"
+JSON="$NAME.json"
+
+echo "program,runner,status,wall_med,wall_min,wall_max,wall_spread" > "$CSV"
+{
+    echo "{"
+    echo "  \"repeats\": $REPS,"
+    echo "  \"results\": ["
+} > "$JSON"
+
+SEP=
+for p in $PROGS
+do
+    B="$TESTDIR/$p.b"
+    IN=/dev/null; [ -f "$TESTDIR/$p.in" ] && IN="$TESTDIR/$p.in"
+    for e in $ENGLIST
+    do
+	runner $e
+	STATUS=ok
+	: > "$TMP/times"
+	i=0
+	while [ $i -lt "$REPS" ]
+	do
+	    i=`expr $i + 1`
+	    START=`now`
+	    $TO $CMD "$B" < "$IN" > "$TMP/out" 2>/dev/null
+	    RV=$?
+	    END=`now`
+	    if [ $RV -eq 124 ]
+	    then STATUS=timeout; break
+	    fi
+	    if [ $RV -ne 0 ]
+	    then STATUS=failed; break
+	    fi
+	    if [ -f "$TESTDIR/$p.out" ] && ! cmp -s "$TMP/out" "$TESTDIR/$p.out"
+	    then STATUS=wrong; break
+	    fi
+	    echo $START $END | awk '{printf "%.6f\n", $2-$1}' >> "$TMP/times"
+	done
+
+	set -- `stats < "$TMP/times"`
+	WMED=$1 WMIN=$2 WMAX=$3
+	SPREAD=`echo $WMED $WMIN $WMAX |
+	    awk '{ if ($1 > 0) printf "%.1f", ($3-$2)*100/$1; else print 0 }'`
+
+	printf >&2 "%-12s %-10s %-8s %ss (%s%%)\n" $p $e $STATUS $WMED $SPREAD
+
+	echo "$p,$e,$STATUS,$WMED,$WMIN,$WMAX,$SPREAD" >> "$CSV"
+	printf "$SEP" >> "$JSON"
+	printf '    {"program": "%s", "runner": "%s", "status": "%s", "wall_time": {"median": %s, "min": %s, "max": %s, "spread_pct": %s}}' \
+	    $p $e $STATUS $WMED $WMIN $WMAX $SPREAD >> "$JSON"
+	SEP=',\n'
+    done
+done
+
+{
+    echo
+    echo "  ]"
+    echo "}"
+} >> "$JSON"
+
+echo >&2 "Results in $CSV and $JSON"
@@ -0,0 +1,339 @@
+/*
+ *  This program generates BF programs for stress testing interpreters.
+ *
+ *  Each kind of program has a size knob so the optimiser, compile and run
+ *  times of an engine can be charted as the knob grows:
+ *
+ *	nest D C	D nested loops that each run C times (C < 256).
+ *	rail L S R	Scan R times along a rail of L cells at a stride of S.
+ *	sweep M R	Add to then subtract from every one of M cells R times.
+ *	line K [W]	K tokens of straight line code over W cells (16).
+ *	print N		Write N bytes.
+ *
+ *  The counts may have a suffix of k, M or G.
+ *
+ *  All the counts are below 256 in the generated code so any cell size can
+ *  run it. Each program starts with a ',' into one of its counters; run it
+ *  with an empty input. This stops the optimiser working out the whole
+ *  program before it's run, so it has to be run.
+ *
+ *  Repeat counts above 100 are built from nested loops of 100; these use
+ *  the cells before cell 12 and the program works at cell 12 and beyond.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define WORK	12	/* Cells before this are repeat counters */
+#define BASE	100
+
+void usage(void);
+void move_to(long cell);
+void put_ch(int ch);
+void put_str(const char * s);
+void put_run(int ch, long count);
+void rep(unsigned long long n, void (*body)(void));
+unsigned long long count_arg(const char * s);
+
+void gen_nest(int depth, int count);
+void gen_rail(void);
+void gen_line(unsigned long long tokens, int width);
+void gen_print(void);
+
+void body_rail(void);
+void body_sweep(void);
+void body_print(void);
+unsigned long rnd(unsigned long n);
+
+int maxcol = 72, col = 0;
+long cur = 0;
+unsigned long seed = 1;
+
+/* Knobs for the loop bodies */
+long rail_len = 0, rail_stride = 1;
+
+int
+main(int argc, char ** argv)
+{
+    for(;;) {
+	if (argc < 2 || argv[1][0] != '-' || argv[1][1] == '\0') {
+	    break;
+	} else if (strcmp(argv[1], "--") == 0) {
+	    argc--; argv++;
+	    break;
+	} else if (strncmp(argv[1], "-w", 2) == 0 && argv[1][2] >= '0' && argv[1][2] <= '9') {
+	    maxcol = atol(argv[1]+2);
+	    argc--; argv++;
+	} else if (strcmp(argv[1], "-w") == 0) {
+	    maxcol = 0;
+	    argc--; argv++;
+	} else if (strncmp(argv[1], "-s", 2) == 0 && argv[1][2] >= '0' && argv[1][2] <= '9') {
+	    seed = strtoul(argv[1]+2, 0, 10);
+	    argc--; argv++;
+	} else
+	    usage();
+    }
+
+    if (argc < 2) usage();
+
+    if (strcmp(argv[1], "nest") == 0 && argc == 4) {
+	unsigned long long d = count_arg(argv[2]), c = count_arg(argv[3]);
+	if (d < 1 || c < 1 || c > 255) usage();
+	gen_nest((int)d, (int)c);
+    } else if (strcmp(argv[1], "rail") == 0 && argc == 5) {
+	rail_len = (long)count_arg(argv[2]);
+	rail_stride = (long)count_arg(argv[3]);
+	if (rail_len < 1 || rail_stride < 1) usage();
+	gen_rail();
+	rep(count_arg(argv[4]), body_rail);
+    } else if (strcmp(argv[1], "sweep") == 0 && argc == 4) {
+	rail_len = (long)count_arg(argv[2]);
+	rail_stride = 1;
+	if (rail_len < 1) usage();
+	gen_rail();
+	rep(count_arg(argv[3]), body_sweep);
+    } else if (strcmp(argv[1], "line") == 0 && (argc == 3 || argc == 4)) {
+	int w = argc == 4 ? (int)count_arg(argv[3]) : 16;
+	if (w < 1) usage();
+	gen_line(count_arg(argv[2]), w);
+    } else if (strcmp(argv[1], "print") == 0 && argc == 3) {
+	gen_print();
+	rep(count_arg(argv[2]), body_print);
+    } else
+	usage();
+
+    /* A newline at the end so the output isn't empty. */
+    move_to(WORK);
+    put_str("[-]++++++++++.");
+    if (col) putchar('\n');
+    return 0;
+}
+
+void
+usage(void)
+{
+    fprintf(stderr, "Usage: bfgen [-w[cols]] [-sSEED] kind args\n"
+	"    nest D C       D nested loops that each run C times (C < 256)\n"
+	"    rail L S R     Scan R times along L cells at a stride of S\n"
+	"    sweep M R      Add to then subtract from M cells R times\n"
+	"    line K [W]     K tokens of straight line code over W cells\n"
+	"    print N        Write N bytes\n"
+	"Counts may have a suffix of k, M or G. Run the result with no input.\n");
+    exit(1);
+}
+
+unsigned long long
+count_arg(const char * s)
+{
+    char * e = 0;
+    unsigned long long n = strtoull(s, &e, 10);
+    if (e == s) usage();
+    switch(*e) {
+    case 'k': n *= 1000; e++; break;
+    case 'M': n *= 1000000; e++; break;
+    case 'G': n *= 1000000000; e++; break;
+    }
+    if (*e) usage();
+    return n;
+}
+
+void
+put_ch(int ch)
+{
+    putchar(ch);
+    if (maxcol && ++col >= maxcol) {
+	putchar('\n');
+	col = 0;
+    }
+}
+
+void
+put_str(const char * s)
+{
+    while(*s) put_ch(*s++);
+}
+
+void
+put_run(int ch, long count)
+{
+    while(count-- > 0) put_ch(ch);
+}
+
+void
+move_to(long cell)
+{
+    if (cell > cur) put_run('>', cell - cur);
+    else put_run('<', cur - cell);
+    cur = cell;
+}
+
+/*
+ * Run the body n times; the body starts and ends on cell WORK. Each base
+ * 100 digit of n is a nest of counted loops using the counter cells below
+ * WORK. The first counter reads the input too, which adds nothing.
+ */
+void
+rep(unsigned long long n, void (*body)(void))
+{
+    int digit[WORK], ndigits = 0, i, j, first = 1;
+
+    while(n > 0 && ndigits < WORK) {
+	digit[ndigits++] = (int)(n % BASE);
+	n /= BASE;
+    }
+    if (n > 0) {
+	fprintf(stderr, "Repeat count is too large\n");
+	exit(1);
+    }
+
+    for(i=ndigits-1; i>=0; i--) {
+	if (digit[i] == 0) continue;
+	move_to(i);
+	if (first) put_ch(',');
+	first = 0;
+	put_run('+', digit[i]);
+	put_ch('[');
+	for(j=i-1; j>=0; j--) {
+	    move_to(j);
+	    put_run('+', BASE);
+	    put_ch('[');
+	}
+	move_to(WORK);
+	body();
+	for(j=0; j<i; j++) {
+	    move_to(j);
+	    put_str("-]");
+	}
+	move_to(i);
+	put_str("-]");
+    }
+}
+
+/* The accumulator at cell depth+1 ends up with count^depth added. */
+void
+gen_nest(int depth, int count)
+{
+    int i;
+
+    for(i=0; i<depth; i++) {
+	move_to(i);
+	if (i == 0) put_ch(',');
+	put_run('+', count);
+	put_ch('[');
+    }
+    move_to(depth+1);
+    put_ch('+');
+    for(i=depth-1; i>=0; i--) {
+	move_to(i);
+	put_str("-]");
+    }
+    move_to(depth+1);
+    put_ch('.');
+}
+
+/*
+ * Put a one in every stride'th cell after WORK for rail_len cells. Each
+ * chunk of up to 255 is laid by a counter that carries itself along.
+ */
+void
+gen_rail(void)
+{
+    long left = rail_len, c;
+
+    move_to(WORK + rail_stride);
+    while(left > 0) {
+	c = left > 255 ? 255 : left;
+	left -= c;
+	put_run('+', c);
+	put_str("[[-");
+	put_run('>', rail_stride);
+	put_ch('+');
+	put_run('<', rail_stride);
+	put_str("]+");
+	put_run('>', rail_stride);
+	put_str("-]");
+	cur += c * rail_stride;
+    }
+    move_to(WORK);
+}
+
+/* Out to the zero at the end of the rail and back to WORK. */
+void
+body_rail(void)
+{
+    put_run('>', rail_stride);
+    put_ch('[');
+    put_run('>', rail_stride);
+    put_ch(']');
+    put_run('<', rail_stride);
+    put_ch('[');
+    put_run('<', rail_stride);
+    put_ch(']');
+}
+
+void
+body_sweep(void)
+{
+    put_str(">[+>]<[-<]");
+}
+
+void
+body_print(void)
+{
+    put_ch('.');
+}
+
+void
+gen_print(void)
+{
+    move_to(WORK);
+    put_run('+', '*');
+}
+
+unsigned long
+rnd(unsigned long n)
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return (seed >> 16) % n;
+}
+
+/*
+ * Random adds and moves over the cells from WORK; they're all read from
+ * the input first and written at the end so nothing can be dropped.
+ */
+void
+gen_line(unsigned long long tokens, int width)
+{
+    unsigned long long done = 0;
+    long cell, n;
+    int i;
+
+    for(i=0; i<width; i++) {
+	move_to(WORK+i);
+	put_ch(',');
+    }
+
+    while(done < tokens) {
+	switch(rnd(3)) {
+	case 0: case 1:
+	    n = 1 + (long)rnd(8);
+	    if (done + (unsigned long long)n > tokens)
+		n = (long)(tokens - done);
+	    put_run(rnd(2) ? '+' : '-', n);
+	    done += (unsigned long long)n;
+	    break;
+	case 2:
+	    cell = WORK + (long)rnd((unsigned long)width);
+	    n = cell > cur ? cell - cur : cur - cell;
+	    if (done + (unsigned long long)n > tokens) break;
+	    move_to(cell);
+	    done += (unsigned long long)n;
+	    break;
+	}
+    }
+
+    for(i=0; i<width; i++) {
+	move_to(WORK+i);
+	put_ch('.');
+    }
+}
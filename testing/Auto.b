@@ -0,0 +1,14 @@
+Automatic engine choice
+
+For each digit of the input up to the newline a line of that many
+letters of the alphabet is written; the program is run twice with the
+same history file and must give the same output with whichever engine
+is chosen each time
+
+>,----------[
+    --------------------------------------
+    >++++++++[>++++++++<-]>+
+    <<[>>.+<<-]
+    >>[-]++++++++++.[-]
+    <<,----------
+]
@@ -0,0 +1,8 @@
+Batch runs
+
+Each character of the line of input is written plus one then a newline;
+the program is run with a list of copies of the input file and each
+output file must be the same
+
+,----------[+++++++++++.,----------]
+++++++++++.
@@ -0,0 +1,72 @@
+Checks for 128 bit cells
+
+The input is the digit one so the optimiser can't work out any of
+the numbers before the program runs; each line of output is a check
+and ends in FAILED if the check is wrong
+
+,------------------------------------------------
+[->+>+<<]>>[-<<+>>]<[[->++<]>[-<+>]>+<<]>>------------------------------
+------------------------------------------------------------------------
+-------------------------->+<[>>>>>>>++++++++[<<++++>++++++++++++>-]<<++
++++++++++++++++.+.++++++.------------------------.>++++.+++++++++++.++++
+++.-------------------.++++++++++.---.+++++.-------.++++++++++++.<.>++++
+.-----.-----------------.+++++++++++++++.<.>---------------.<.>++.++.+++
+++++..<.++++++++++++++++++++++++++++++++++++++.-----.++++++++.+++.------
+-.-.----------------------------------------------------------.[-]>[-]<<
+<<<-<[-]]>[>>>>>>++++++++[<<++++>++++++++++++>-]<<+++++++++++++++++.+.++
+++++.------------------------.>++++.+++++++++++.++++++.-----------------
+--.++++++++++.---.+++++.-------.++++++++++++.<.>++++.-----.-------------
+----.+++++++++++++++.<.>---------------.<.>++.++.+++++++..<-------------
+---------.[-]>[-]<<<<<-]
+<<<<[->>>>>+<<<+<<]>>[-<<+>>]>>>>>++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++[<<[-<<<++>>>]<<<[->>>+<<<]>>>>>-]<<<<<<<[->>>
+>>>+<<<<+<<]>>[-<<+>>]>>>>[-<->]<<<<<<[->>>>>>+<<<<+<<]>>[-<<+>>]>>>>[-<
++>]<<<<<<[->>>>>>+<<<<+<<]>>[-<<+>>]>>>>>+++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++++[<[-<<<<++>>>>]<<<<[->>>>+<<<<]>>>>>-]<
+[-<->]<<+>[>>>>>++++++++[<<++++>++++++++++++>-]<<++++++++++++++++++.>--.
+<++++.--.--------------------.>+++++.--.+++++++++++++++++..---------.---
+-.++++++++++++++.<.>----------.+++++.++++++.-----.<.>+++++.------------.
+---.<.>+++++++++++++++.-----.+.<.>--------.-------.+++++++++++.------.<.
+>--------------------------------.-----.++++++++.+++.-------.-.<--------
+--------------.[-]>[-]<<<<<->[-]]<[>>>>>>++++++++[<<++++>++++++++++++>-]
+<<++++++++++++++++++.>--.<++++.--.--------------------.>+++++.--.+++++++
+++++++++++..---------.----.++++++++++++++.<.>----------.+++++.++++++.---
+--.<.>+++++.------------.---.<.>+++++++++++++++.-----.+.<.>--------.----
+---.+++++++++++.------.<----------------------.[-]>[-]<<<<<-]
+<<<<[->>>>>+<<<+<<]>>[-<<+>>]>>>>>++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++[<<[-<<<++>>>]<<<[->>>+<<<]>>>>>-]<<[-<<<+++>>>]<<<[->>>
++<<<]<<[->>>>>>+<<<<+<<]>>[-<<+>>]>>>>>+++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++++++++++[<[-<<<<++>>>>]<<<<[->>>>+<<<<]>>>>>-]<[-<+>]<<+>[>
+>>>>++++++++[<<++++>++++++++++++>-]<<+++++++++++++++++++.---------------
+----.>++++++++++++++++++++.-----------.++++.--------.++++++++++++++.<.++
+++++++++++++++++.>---------------------.<-.+.++++.----------------------
+.>++++++++++++++++++.----.+++++++++.--.<.++++++++++++++++++.>-----------
+----------.<-.+.++++.----------------------.>+++++++++++.++++++++++.<.>+
+++++++.---------------------.+++++++++++++.---.<.+++++++++++++++++++++++
++++++++++++++++.-----.++++++++.+++.-------.-.---------------------------
+-------------------------------.[-]>[-]<<<<<->[-]]<[>>>>>>++++++++[<<+++
++>++++++++++++>-]<<+++++++++++++++++++.-------------------.>++++++++++++
+++++++++.-----------.++++.--------.++++++++++++++.<.++++++++++++++++++.>
+---------------------.<-.+.++++.----------------------.>++++++++++++++++
+++.----.+++++++++.--.<.++++++++++++++++++.>---------------------.<-.+.++
+++.----------------------.>+++++++++++.++++++++++.<.>+++++++.-----------
+----------.+++++++++++++.---.<----------------------.[-]>[-]<<<<<-]
+<<<<[->>>>>+<<<+<<]>>[-<<+>>]>>>>>++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++++++[<<[-<<<++>>>]<<<[->>>+<<<]>>>>>-]<<<<<<<[->>>>>>+<<<<+
+<<]>>[-<<+>>]>>>>[-<+>]<<<<<<[->>>>>>+<<<<+<<]>>[-<<+>>]>>>>[-<<<<->>>>]
+<<<<[->>>-<<<]<<[->>>>>>+<<<<+<<]>>[-<<+>>]>>>>>++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++[<[-<<<<++>>>>]<<<<[->>>>+<<<<]>>>>>-]<[-
+<+>]<--<+>[>>>>>++++++++[<<++++>++++++++++++>-]<<++++++++++++++++++.>--.
+<-.+.+++++.-----------------------.>+++.+++++++++++++.----------.<.>++++
++++++.----.+++++.+++++++.--.<.>----.-.---------.<.>----.++++++++++++++++
++.-------------.<.>++++++.------.+++++++++++.++++.<.++++++++++++++++++++
+++++++++++++++++++.-----.++++++++.+++.-------.-.------------------------
+----------------------------------.[-]>[-]<<<<<->[-]]<[>>>>>>++++++++[<<
+++++>++++++++++++>-]<<++++++++++++++++++.>--.<-.+.+++++.----------------
+-------.>+++.+++++++++++++.----------.<.>+++++++++.----.+++++.+++++++.--
+.<.>----.-.---------.<.>----.+++++++++++++++++.-------------.<.>++++++.-
+-----.+++++++++++.++++.<----------------------.[-]>[-]<<<<<-]
@@ -0,0 +1,142 @@
+Checks for 16 bit cells on the native 16 bit tape
+
+The input is the digit one so the optimiser can't work out any of
+the numbers before the program runs; each line of output is a check
+and ends in FAILED if the check is wrong
+
+The scans run over cells that are zero in their bottom byte so a
+scan that looks at bytes stops too soon
+
+,------------------------------------------------
+[->+>+<<]>>[-<<+>>]<[[->++<]>[-<+>]>+<<]>>---------------->+<[>>>>>>>+++
++++++[<<++++>++++++++++++>-]<<+++++++++++++++++.+++++.------------------
+----.>++++.+++++++++++.++++++.-------------------.++++++++++.---.+++++.-
+------.++++++++++++.<.>++++.-----.-----------------.+++++++++++++++.<.>-
+--------------.<.>++.++.+++++++..<.+++++++++++++++++++++++++++++++++++++
++.-----.++++++++.+++.-------.-.-----------------------------------------
+-----------------.[-]>[-]<<<<<-<[-]]>[>>>>>>++++++++[<<++++>++++++++++++
+>-]<<+++++++++++++++++.+++++.----------------------.>++++.+++++++++++.++
+++++.-------------------.++++++++++.---.+++++.-------.++++++++++++.<.>++
+++.-----.-----------------.+++++++++++++++.<.>---------------.<.>++.++.+
+++++++..<----------------------.[-]>[-]<<<<<-]
+<<<<[->>>>>+<<<+<<]>>[-<<+>>]>>>>>++++++++[<<[-<<<++>>>]<<<[->>>+<<<]>>>
+>>-]<<<<<<<[->>>>>>+<<<<+<<]>>[-<<+>>]>>>>[-<->]<<<<<<[->>>>>>+<<<<+<<]>
+>[-<<+>>]>>>>[-<+>]<<<<<<[->>>>>>+<<<<+<<]>>[-<<+>>]>>>>>++++++++[<[-<<<
+<++>>>>]<<<<[->>>>+<<<<]>>>>>-]<[-<->]<<+>[>>>>>++++++++[<<++++>++++++++
+++++>-]<<++++++++++++++++++.>--.<++++++.------------------------.>+++++.
+--.+++++++++++++++++..---------.----.++++++++++++++.<.>----------.+++++.
+++++++.-----.<.>+++++.------------.---.<.>+++++++++++++++.-----.+.<.>---
+-----.-------.+++++++++++.------.<.>--------------------------------.---
+--.++++++++.+++.-------.-.<----------------------.[-]>[-]<<<<<->[-]]<[>>
+>>>>++++++++[<<++++>++++++++++++>-]<<++++++++++++++++++.>--.<++++++.----
+--------------------.>+++++.--.+++++++++++++++++..---------.----.+++++++
++++++++.<.>----------.+++++.++++++.-----.<.>+++++.------------.---.<.>++
++++++++++++++.-----.+.<.>--------.-------.+++++++++++.------.<----------
+------------.[-]>[-]<<<<<-]
+<<<<[->>>>>+<<<+<<]>>[-<<+>>]>>>>>++++++++++++++[<<[-<<<++>>>]<<<[->>>+<
+<<]>>>>>-]<<[-<<<+++>>>]<<<[->>>+<<<]<<[->>>>>>+<<<<+<<]>>[-<<+>>]>>>>>+
++++++++++++++[<[-<<<<++>>>>]<<<<[->>>>+<<<<]>>>>>-]<[-<+>]<<+>[>>>>>++++
+++++[<<++++>++++++++++++>-]<<+++++++++++++++++++.-------------------.>++
+++++++++++++++++++.-----------.++++.--------.++++++++++++++.<.++++++++++
+++++++++.>---------------------.<-.+++.--------------------.>+++++++++++
++++++++.----.+++++++++.--.<.++++++++++++++++++.>---------------------.<-
+.+++.--------------------.>+++++++++++.++++++++++.<.>+++++++.-----------
+----------.+++++++++++++.---.<.++++++++++++++++++++++++++++++++++++++.--
+---.++++++++.+++.-------.-.---------------------------------------------
+-------------.[-]>[-]<<<<<->[-]]<[>>>>>>++++++++[<<++++>++++++++++++>-]<
+<+++++++++++++++++++.-------------------.>++++++++++++++++++++.---------
+--.++++.--------.++++++++++++++.<.++++++++++++++++++.>------------------
+---.<-.+++.--------------------.>++++++++++++++++++.----.+++++++++.--.<.
+++++++++++++++++++.>---------------------.<-.+++.--------------------.>+
+++++++++++.++++++++++.<.>+++++++.---------------------.+++++++++++++.---
+.<----------------------.[-]>[-]<<<<<-]
+<<<<[->>>>>+<<<+<<]>>[-<<+>>]>>>>>+++++++++++++++[<<[-<<<++>>>]<<<[->>>+
+<<<]>>>>>-]<<<<<<<[->>>>>>+<<<<+<<]>>[-<<+>>]>>>>[-<+>]<<<<<<[->>>>>>+<<
+<<+<<]>>[-<<+>>]>>>>[-<<<<->>>>]<<<<[->>>-<<<]<<[->>>>>>+<<<<+<<]>>[-<<+
+>>]>>>>>+++++++++++++++[<[-<<<<++>>>>]<<<<[->>>>+<<<<]>>>>>-]<[-<+>]<--<
++>[>>>>>++++++++[<<++++>++++++++++++>-]<<++++++++++++++++++.>--.<-.++++.
+---------------------.>+++.+++++++++++++.----------.<.>+++++++++.----.++
++++.+++++++.--.<.>----.-.---------.<.>----.+++++++++++++++++.-----------
+--.<.>++++++.------.+++++++++++.++++.<.+++++++++++++++++++++++++++++++++
++++++.-----.++++++++.+++.-------.-.-------------------------------------
+---------------------.[-]>[-]<<<<<->[-]]<[>>>>>>++++++++[<<++++>++++++++
+++++>-]<<++++++++++++++++++.>--.<-.++++.---------------------.>+++.+++++
+++++++++.----------.<.>+++++++++.----.+++++.+++++++.--.<.>----.-.-------
+--.<.>----.+++++++++++++++++.-------------.<.>++++++.------.+++++++++++.
+++++.<----------------------.[-]>[-]<<<<<-]
+<<<<[->>>>>>>>>>>>>>>>>>>>+<<<<<<<<<<<<<<<<<<+<<]>>[-<<+>>]>>>>>++++++++
+[>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<++>>>>>>>>>>>>>>>>>>]<<<<<<<<<<<<<<<<<
+<[->>>>>>>>>>>>>>>>>>+<<<<<<<<<<<<<<<<<<]>>>>>-]>>>>>>>>>>>>>[->>+>+>+>+
+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+
+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<]<<<<<<<<<<<<<<<<<<<<[->>>>>>>>
+>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>+<<<<<<<<<<<<<<<<<
+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<+<<]>>[-<<+>>]
+>>>>>>>>>>>>>>>>>>>>[>]+<[<]>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>-<
+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>
+>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>[<<<<<<<<<<<<<<<<<<<<<<<<<
+<<<<<<<<<<<<<<<<<<<<<<<<<<<<++++++++[<<++++>++++++++++++>-]<+.<.>+++++++
+++++++++++.---------.--.+.++++++++++++.<.>-.----------------.--.++++++++
++++++.<.>+++++.+.-----.+.+++.<.>------------------.+++++++++++++++++++.<
+.>-------------------.<.>+++++++++++++++++++++++++.---------------------
+.+++++++++++++.---.<.>------------.++.+++++++..<.+++++++++++++++++++++++
++++++++++++++++.-----.++++++++.+++.-------.-.---------------------------
+-------------------------------.[-]>[-]<<<<<->>>>>>>>>>>>>>>>>>>>>>>>>>>
+>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>[-]]<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+<<<<<<<<<<<<<<<<<<<<<<<[>>>>>>++++++++[<<++++>++++++++++++>-]<+.<.>+++++
+++++++++++++.---------.--.+.++++++++++++.<.>-.----------------.--.++++++
++++++++.<.>+++++.+.-----.+.+++.<.>------------------.+++++++++++++++++++
+.<.>-------------------.<.>+++++++++++++++++++++++++.-------------------
+--.+++++++++++++.---.<.>------------.++.+++++++..<----------------------
+.[-]>[-]<<<<<-]
+<<<<[->>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+>>>>+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+<+<<]>>[-<<+>>]>>>>>+++++++++[>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+>>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+<<<<<<<<<<<<<<<<<<<++>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+>>>>>>>>>>>>>>>>>]<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+>>>>>>>>>>>>+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+<<<<<<<<<]>>>>>-]>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+>>>>>>>>[->>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>
++>+>+>+>+>+>+>+>+>+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<]<<<<<<<<<<<
+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<[->>>>>>>>>>>
+>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>+<<<<<<<<<<
+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<+<<]>>[-<<+>
+>]
+>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>[<]+>[>]<<<<<<<<<<<<<<<<<<<<<<<<<<<
+<<<<<<<<<<<<<<-<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+>>>>>>[<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<++++
+++++[<<++++>++++++++++++>-]<+.<.>+++++++++++.-------.+.++++++++++++++.<.
+>-.----------------.--.+++++++++++++.<.>+++++.+.-----.+.+++.<.>---------
+---------.+++++++++++++++++++.<.>-------------------.<.>++++++++++++++++
++++++++++.---------------------.+++++++++++++.---.<.>------------.++.+++
+++++..<.++++++++++++++++++++++++++++++++++++++.-----.++++++++.+++.------
+-.-.----------------------------------------------------------.[-]>[-]<<
+<<<->>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>[
+-]]<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<[>
+>>>>>++++++++[<<++++>++++++++++++>-]<+.<.>+++++++++++.-------.+.++++++++
+++++++.<.>-.----------------.--.+++++++++++++.<.>+++++.+.-----.+.+++.<.>
+------------------.+++++++++++++++++++.<.>-------------------.<.>+++++++
+++++++++++++++++++.---------------------.+++++++++++++.---.<.>----------
+--.++.+++++++..<----------------------.[-]>[-]<<<<<-]
+<<<<[->>>>>+<<<+<<]>>[-<<+>>]>>>>>++++++++[<<[-<<<++>>>]<<<[->>>+<<<]>>>
+>>-]<<[-<<<+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++>>>]<<<[->>>+<<<]<<[->
+>>>>>+<<<<+<<]>>[-<<+>>]>>>>>++++++++[<[-<<<<++>>>>]<<<<[->>>>+<<<<]>>>>
+>-]<[-<+>]<<+>[>>>>>++++++++[<<++++>++++++++++++>-]<<++++++++++++++++++.
++++..---------------------.>++++++++++++++++++++.-----------.++++.------
+--.++++++++++++++.<.++++++++++++++++++.+++.+.----------------------.>---
+.----.+++++++++.--.<.++++++++++++++++++.+++.+.----------------------.>--
+--------.++++++++++.<.>+++++++.---------------------.+++++++++++++.---.<
+.++++++++++++++++++++++++++++++++++++++.-----.++++++++.+++.-------.-.---
+-------------------------------------------------------.[-]>[-]<<<<<->[-
+]]<[>>>>>>++++++++[<<++++>++++++++++++>-]<<++++++++++++++++++.+++..-----
+----------------.>++++++++++++++++++++.-----------.++++.--------.+++++++
++++++++.<.++++++++++++++++++.+++.+.----------------------.>---.----.++++
++++++.--.<.++++++++++++++++++.+++.+.----------------------.>----------.+
++++++++++.<.>+++++++.---------------------.+++++++++++++.---.<----------
+------------.[-]>[-]<<<<<-]
@@ -0,0 +1,13 @@
+Hang
+
+A line is written then the program reads a digit and goes round a loop
+that changes a cell but leaves the tape the same each time; the run must
+be stopped by the watchdog or the loop limit with the output written
+so far and the place of the loop in the message
+
+>>>>++++++++[<<++++>++++++++++++>-]<-------------------------.++++++++++
+++++++++++++++++++++++++++++++.------.+++++.-------.<.>+++++++++++.---.+
++++++.-------.----------.<.>+++++.+++++.<.>-----------.++++++.+++++++++.
+---------------.+++++++++.-------.++++++++++++++.<----------------------
+.[-]>[-]
+<<<,[>[-]+<]
@@ -0,0 +1,11 @@
+Decimal input and output with fintio
+
+Each number up to a zero is read and written back then the sum of
+them is written followed by minus the sum and the count of numbers
+
+,[
+    >>+<<			count it
+    [->+>>+<<<]>>>[-<<<+>>>]<<<	add it to the sum
+    .,
+]
+>.[->>-<<]>>.<.
@@ -0,0 +1,12 @@
+Loop counters
+
+For each digit of the input up to the newline a line with that many
+stars is written; the inner loop is entered once for each digit and
+runs for the sum of the digits
+
+>>++++++[<+++++++>-]++++++++++<<	a star and a newline
+,----------[
+    --------------------------------------
+    [>.<-]>>.<<
+    ,----------
+]
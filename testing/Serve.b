@@ -0,0 +1,9 @@
+Job server
+
+The line of input is written backwards followed by a newline; the
+program is sent to a server by several clients at once and each must
+get the whole of its own output
+
+>,----------[++++++++++>,----------]
+<[.<]
+++++++++++.
@@ -0,0 +1,14 @@
+A short program for the binary trace
+
+For each digit of the input up to the newline a line with that many
+stars is written as for Loops; the digits are added into a total with
+a copy loop and the total is written at the end
+
+>>++++++[<+++++++>-]++++++++++<<	a star and a newline
+,----------[
+    --------------------------------------
+    [->>>+>+<<<<]>>>>[-<<<<+>>>>]<<<<	add it to the total
+    [>.<-]>>.<<
+    ,----------
+]
+>>>++++++++++++++++++++++++++++++++++++++++++++++++.<.
@@ -0,0 +1,180 @@
+/*
+ * The -fauto-engine choice; made once the program has been optimised.
+ *
+ * Each engine has a guess of its compile time, a fixed part plus a part
+ * for each node, and of how many times faster than the array interpreter
+ * it runs the program. The time the array interpreter would take, the
+ * "work", is guessed from the tree and the engine with the smallest
+ * compile plus run time is used.
+ *
+ * With --auto-history=file each run adds a line with a hash of the
+ * optimised tree, the engine and the times it took. When the program is
+ * run again the measured times are used for the engines that have been
+ * tried and the work is taken from them for the others; so an engine that
+ * ought to be quicker gets tried, and is kept if it really is quicker.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bfi.tree.h"
+#include "bfi.run.h"
+#include "autosel.h"
+
+int opt_auto_engine = 0;
+char * auto_history = 0;
+
+static struct engine_model {
+    const char * name;
+    double fixed, per_node;	/* Compile time, seconds */
+    double speed;		/* Compared to the array interpreter */
+} models[auto_engines] = {
+    { "array",	0.0001, 0.0000002,  1.0 },
+    { "dynasm",	0.0002, 0.0000007,  6.0 },
+    { "cc-O0",	0.08,	0.0001,	    3.0 },
+    { "cc-O1",	0.09,	0.0003,	    8.0 },
+    { "cc-O2",	0.10,	0.0006,	    9.0 },
+};
+
+static struct history {
+    int runs;
+    double compile, run;	/* Totals */
+} hist[auto_engines];
+
+static unsigned long long prog_hash;
+static int chosen = -1;
+
+/* FNV-1a over the parts of the tree that the engines use. */
+static unsigned long long
+tree_hash(void)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    struct bfi * n;
+    int v[7], i;
+
+    for(n=bfprog; n; n=n->next) {
+	v[0] = n->type; v[1] = n->count; v[2] = n->offset;
+	v[3] = n->count2; v[4] = n->offset2;
+	v[5] = n->count3; v[6] = n->offset3;
+	for(i=0; i<7; i++) {
+	    h ^= (unsigned)v[i];
+	    h *= 1099511628211ULL;
+	}
+    }
+    h ^= cell_length;
+    h *= 1099511628211ULL;
+    return h;
+}
+
+static int
+engine_index(const char * name)
+{
+    int i;
+    for(i=0; i<auto_engines; i++)
+	if (!strcmp(name, models[i].name)) return i;
+    return -1;
+}
+
+static void
+read_history(void)
+{
+    FILE * fd;
+    char line[256], name[32];
+    unsigned long long h;
+    double ct, rt;
+    int e;
+
+    if (!auto_history || (fd = fopen(auto_history, "r")) == 0) return;
+    while(fgets(line, sizeof(line), fd)) {
+	if (sscanf(line, "%llx %31s %lf %lf", &h, name, &ct, &rt) != 4)
+	    continue;
+	if (h != prog_hash || (e = engine_index(name)) < 0) continue;
+	hist[e].runs++;
+	hist[e].compile += ct;
+	hist[e].run += rt;
+    }
+    fclose(fd);
+}
+
+/*
+ * A guess at the array interpreter's run time from the shape of the tree.
+ * Without loops it's nothing; big programs that read input are normally
+ * interactive and wait for the user. Otherwise the deeper the loops are
+ * nested the longer the program is likely to run, up to a limit as it's
+ * only a guess; it takes a measured run to make C worth compiling.
+ */
+static double
+guess_work(void)
+{
+    int depth = max_indent < 6 ? max_indent : 6;
+
+    if (node_type_counts[T_WHL] == 0)
+	return 0.0001;
+    if (node_type_counts[T_INP] && total_nodes > 5000)
+	return 0.05;
+    return 0.01 * (1 << depth);
+}
+
+/*
+ * Pick one of the available engines, a bit mask of (1<<auto_xxx). The
+ * array interpreter must be available.
+ */
+int
+auto_choose(unsigned available)
+{
+    double work = 0, cost, best_cost = 0;
+    int e, runs = 0, best = auto_array;
+
+    prog_hash = tree_hash();
+    read_history();
+
+    /* The work measured by every engine tried, as array seconds. */
+    for(e=0; e<auto_engines; e++)
+	if (hist[e].runs) {
+	    work += hist[e].run * models[e].speed;
+	    runs += hist[e].runs;
+	}
+    if (runs) work /= runs;
+    else work = guess_work();
+
+    for(e=0; e<auto_engines; e++) {
+	if (!(available & (1U << e))) continue;
+	if (hist[e].runs)
+	    cost = (hist[e].compile + hist[e].run) / hist[e].runs;
+	else
+	    cost = models[e].fixed + models[e].per_node * total_nodes +
+		    work / models[e].speed;
+	if (e == auto_array || cost < best_cost) {
+	    best = e;
+	    best_cost = cost;
+	}
+    }
+
+    if (verbose)
+	fprintf(stderr, "Auto engine: %d nodes, %d loops, depth %d%s; "
+		"%s work %.6fs, using %s (%.6fs)\n",
+		total_nodes, node_type_counts[T_WHL], max_indent,
+		node_type_counts[T_INP] ? ", reads input" : "",
+		runs ? "measured" : "guessed", work,
+		models[best].name, best_cost);
+
+    chosen = best;
+    return best;
+}
+
+/* Add this run to the history file. */
+void
+auto_record(double compile_time, double run_secs)
+{
+    FILE * fd;
+
+    if (chosen < 0 || !auto_history) return;
+    if ((fd = fopen(auto_history, "a")) == 0) {
+	perror(auto_history);
+	return;
+    }
+    fprintf(fd, "%016llx %s %.6f %.6f\n",
+	    prog_hash, models[chosen].name, compile_time, run_secs);
+    fclose(fd);
+}
@@ -0,0 +1,10 @@
+
+/* The engines -fauto-engine chooses from, as bits for auto_choose() */
+enum auto_engine { auto_array, auto_dynasm, auto_cc0, auto_cc1, auto_cc2,
+		   auto_engines };
+
+extern int opt_auto_engine;
+extern char * auto_history;
+
+int auto_choose(unsigned available);
+void auto_record(double compile_time, double run_secs);
@@ -0,0 +1,209 @@
+/*
+ * The -batch runner; one program run over a list of input files.
+ *
+ * The program is loaded, optimised and compiled by the normal backend as
+ * if it were to be run once. Then, just as the run is about to start,
+ * batch_start() is called by start_runclock() and the process becomes a
+ * dispatcher. For each input file it forks a child which shares the
+ * compiled code copy-on-write; the child puts the input file on stdin and
+ * the output file on stdout and returns to run the program on its own
+ * clean tape. Up to -batch-jobs children run at once.
+ *
+ * The output for "file" goes to "file.out". A line for each job and the
+ * totals are written to stderr.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "clock.h"
+#include "batch.h"
+
+char * batch_list = 0;
+int batch_workers = 0;
+
+struct job {
+    char * name;
+    pid_t pid;
+    double start, time;
+    int status;
+};
+
+static struct job * jobs = 0;
+static int njobs = 0;
+
+static void
+read_list(void)
+{
+    FILE * ifd;
+    char buf[4096];
+    int size = 0;
+
+    if ((ifd = fopen(batch_list, "r")) == 0) {
+	perror(batch_list);
+	exit(1);
+    }
+    while(fgets(buf, sizeof(buf), ifd)) {
+	size_t len = strlen(buf);
+	while (len > 0 && (buf[len-1] == '\n' || buf[len-1] == '\r'))
+	    buf[--len] = 0;
+	if (len == 0) continue;
+	if (njobs >= size) {
+	    size = size ? size*2 : 64;
+	    if ((jobs = realloc(jobs, size * sizeof(*jobs))) == 0) {
+		perror("realloc"); exit(1);
+	    }
+	}
+	memset(jobs+njobs, 0, sizeof(*jobs));
+	if ((jobs[njobs].name = strdup(buf)) == 0) {
+	    perror("strdup"); exit(1);
+	}
+	njobs++;
+    }
+    fclose(ifd);
+}
+
+static off_t
+file_size(const char * name)
+{
+    struct stat st;
+    if (stat(name, &st) < 0) return 0;
+    return st.st_size;
+}
+
+static char *
+out_name(const char * name)
+{
+    char * oname = malloc(strlen(name)+5);
+    if (!oname) { perror("malloc"); exit(1); }
+    strcpy(oname, name);
+    strcat(oname, ".out");
+    return oname;
+}
+
+/* In the child; stdin and stdout become the job's files. */
+static void
+job_files(struct job * j)
+{
+    char * oname;
+    int fd;
+
+    if ((fd = open(j->name, O_RDONLY)) < 0 || dup2(fd, 0) < 0) {
+	perror(j->name);
+	_exit(1);
+    }
+    close(fd);
+
+    oname = out_name(j->name);
+    if ((fd = open(oname, O_WRONLY|O_CREAT|O_TRUNC, 0666)) < 0 ||
+	    dup2(fd, 1) < 0) {
+	perror(oname);
+	_exit(1);
+    }
+    close(fd);
+    free(oname);
+    clearerr(stdin);
+}
+
+void
+batch_start(void)
+{
+    int next = 0, running = 0, done = 0, failed = 0, i;
+    double start, elapsed, in_bytes = 0, out_bytes = 0, job_time = 0;
+    struct rusage ru;
+    pid_t pid;
+    int status;
+
+    read_list();
+    if (batch_workers <= 0) {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	batch_workers = n > 0 ? (int)n : 1;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    start = wall_clock();
+
+    while (done < njobs) {
+	while (next < njobs && running < batch_workers) {
+	    struct job * j = jobs + next++;
+	    j->start = wall_clock();
+	    if ((pid = fork()) == 0) {
+		job_files(j);
+		return;
+	    }
+	    if (pid < 0) {
+		perror("fork");
+		j->status = -1;
+		done++;
+		failed++;
+		continue;
+	    }
+	    j->pid = pid;
+	    running++;
+	}
+	if (running == 0) continue;
+
+	if ((pid = waitpid(-1, &status, 0)) < 0) {
+	    if (errno == EINTR) continue;
+	    perror("waitpid");
+	    exit(1);
+	}
+	for(i=0; i<next; i++)
+	    if (jobs[i].pid == pid) break;
+	if (i >= next) continue;
+
+	running--;
+	done++;
+	jobs[i].pid = 0;
+	jobs[i].status = status;
+	jobs[i].time = wall_clock() - jobs[i].start;
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	    failed++;
+
+	{
+	    double ib = (double)file_size(jobs[i].name), ob;
+	    char * oname = out_name(jobs[i].name);
+	    ob = (double)file_size(oname);
+	    free(oname);
+	    in_bytes += ib;
+	    out_bytes += ob;
+	    job_time += jobs[i].time;
+
+	    fprintf(stderr, "%s: ", jobs[i].name);
+	    if (WIFEXITED(status))
+		fprintf(stderr, "exit %d", WEXITSTATUS(status));
+	    else if (WIFSIGNALED(status))
+		fprintf(stderr, "signal %d", WTERMSIG(status));
+	    fprintf(stderr, ", %.6fs, %.0f bytes in, %.0f bytes out\n",
+		jobs[i].time, ib, ob);
+	}
+    }
+
+    elapsed = wall_clock() - start;
+    fprintf(stderr, "Batch: %d jobs, %d failed, %d workers, %.3fs\n",
+	njobs, failed, batch_workers, elapsed);
+    if (njobs > 0 && elapsed > 0) {
+	fprintf(stderr, "Batch: %.1f jobs/s, %.6fs mean job time, "
+	    "%.3f MB/s in, %.3f MB/s out\n",
+	    njobs / elapsed, job_time / njobs,
+	    in_bytes / elapsed / 1e6, out_bytes / elapsed / 1e6);
+    }
+    if (getrusage(RUSAGE_CHILDREN, &ru) == 0 && elapsed > 0) {
+	double cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6
+		   + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+	fprintf(stderr, "Batch: %.3fs CPU, %.1f cores busy\n",
+	    cpu, cpu / elapsed);
+    }
+
+    exit(failed != 0);
+}
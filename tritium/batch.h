@@ -0,0 +1,5 @@
+
+extern char * batch_list;
+extern int batch_workers;
+
+void batch_start(void);
@@ -0,0 +1,180 @@
+#!/bin/sh
+# Benchmark bfi; every program in ../testing that has a .out file is run
+# with every engine that this bfi has, using the .in file as input.
+#
+# Each run writes a --report so the optimiser, backend compile and run
+# times are kept apart. The median, minimum and maximum of the repeats
+# are written to bench.csv and bench.json, one line per program and
+# engine in a fixed order so two results can be compared with diff(1).
+#
+# The programs with a .opt file need those options, check.sh runs them.
+#
+# Usage: bench.sh [-n repeats] [-t timeout] [-e "engines"] [-o name] [programs]
+#
+# The engines are: tree array maxtree dynasm lightning libtcc gcc
+
+BFI=${BFI:-./bfi}
+TESTDIR=${TESTDIR:-../testing}
+REPS=5
+TIMEOUT=120
+ENGINES="tree array maxtree dynasm lightning libtcc gcc"
+NAME=bench
+
+while [ $# -gt 0 ]
+do
+    case "$1" in
+    -n) REPS="$2"; shift 2;;
+    -t) TIMEOUT="$2"; shift 2;;
+    -e) ENGINES="$2"; shift 2;;
+    -o) NAME="$2"; shift 2;;
+    -*) echo >&2 "Usage: $0 [-n repeats] [-t timeout] [-e engines] [-o name] [programs]"
+	exit 1;;
+    *) break;;
+    esac
+done
+
+PROGS="$*"
+[ "$PROGS" = "" ] && {
+    for f in "$TESTDIR"/*.out
+    do [ -f "${f%.out}.b" -a ! -f "${f%.out}.opt" ] &&
+	PROGS="$PROGS `basename "${f%.out}"`"
+    done
+}
+
+TMP="${TMPDIR:-/tmp}/bench.$$"
+mkdir "$TMP" || exit 1
+trap 'rm -rf "$TMP"' 0
+trap 'exit 1' 1 2 15
+
+TO=
+[ "`which timeout 2>/dev/null`" != "" ] && TO="timeout $TIMEOUT"
+
+# The bfi options and the backend name the --report must show.
+engine() {
+    case "$1" in
+    tree)	OPTS="-r -vvv";		BE=tree;;
+    array)	OPTS="-r";		BE=array;;
+    maxtree)	OPTS="-r -b48";		BE=maxtree;;
+    dynasm)	OPTS="-q";		BE=dynasm;;
+    lightning)	OPTS="-j";		BE=gnulightning;;
+    libtcc)	OPTS="-c -r -ltcc";	BE=ccode;;
+    gcc)	OPTS="-c -r -ldl";	BE=ccode;;
+    *) return 1;;
+    esac
+}
+
+# Get "optimise compile run" times and the backend from a report.
+report() {
+    awk '
+	/"nodes_before"/ { sub(/.*"time": /, ""); sub(/,.*/, ""); opt += $0 }
+	/"backend"/ {
+	    be = $0; sub(/.*"name": "/, "", be); sub(/".*/, "", be)
+	    ct = $0; sub(/.*"compile_time": /, "", ct); sub(/}.*/, "", ct)
+	}
+	/"run": {/ { rt = $0; sub(/.*"time": /, "", rt); sub(/,.*/, "", rt) }
+	END { if (be != "") printf "%.6f %s %s %s\n", opt, ct, rt, be }
+    ' "$1"
+}
+
+# Median, minimum and maximum of the numbers on stdin.
+stats() {
+    sort -g | awk '
+	{ v[NR] = $1 }
+	END {
+	    if (NR == 0) { print "0 0 0"; exit }
+	    if (NR % 2) m = v[(NR+1)/2]; else m = (v[NR/2] + v[NR/2+1]) / 2
+	    printf "%.6f %.6f %.6f\n", m, v[1], v[NR]
+	}'
+}
+
+# An engine is available if it runs a program that needs input to finish.
+available() {
+    engine "$1" || return 1
+    rm -f "$TMP/report"
+    { X=`$TO $BFI $OPTS --report="$TMP/report" -I A -P ',+.'`; } 2>/dev/null
+    [ "$X" = B ] || return 1
+    [ "`report "$TMP/report" | awk '{print $4}'`" = "$BE" ]
+}
+
+VERSION=`$BFI -h 2>&1 | sed -n 's/^[^:]*: Version //p' | head -1`
+
+ENGLIST=
+for e in $ENGINES
+do
+    if available $e
+    then ENGLIST="$ENGLIST $e"
+    else echo >&2 "Engine $e is not available"
+    fi
+done
+
+CSV="$NAME.csv"
+JSON="$NAME.json"
+
+echo "program,engine,backend,status,opt_time,compile_med,compile_min,compile_max,run_med,run_min,run_max,run_spread" > "$CSV"
+{
+    echo "{"
+    echo "  \"version\": \"$VERSION\","
+    echo "  \"repeats\": $REPS,"
+    echo "  \"results\": ["
+} > "$JSON"
+
+SEP=
+for p in $PROGS
+do
+    B="$TESTDIR/$p.b"
+    IN=/dev/null; [ -f "$TESTDIR/$p.in" ] && IN="$TESTDIR/$p.in"
+    for e in $ENGLIST
+    do
+	engine $e
+	STATUS=ok
+	: > "$TMP/times"
+	i=0
+	while [ $i -lt "$REPS" ]
+	do
+	    i=`expr $i + 1`
+	    rm -f "$TMP/report"
+	    $TO $BFI $OPTS --report="$TMP/report" "$B" < "$IN" \
+		> "$TMP/out" 2>/dev/null
+	    RV=$?
+	    if [ $RV -eq 124 ]
+	    then STATUS=timeout; break
+	    fi
+	    if [ $RV -ne 0 -o ! -s "$TMP/report" ]
+	    then STATUS=failed; break
+	    fi
+	    if [ -f "$TESTDIR/$p.out" ] && ! cmp -s "$TMP/out" "$TESTDIR/$p.out"
+	    then STATUS=wrong; break
+	    fi
+	    report "$TMP/report" >> "$TMP/times"
+	done
+
+	BACKEND=`awk 'END{print $4}' "$TMP/times"`
+	[ "$BACKEND" = "" ] && BACKEND=none
+	set -- `awk '{print $1}' "$TMP/times" | stats`
+	OPT=$1
+	set -- `awk '{print $2}' "$TMP/times" | stats`
+	CMED=$1 CMIN=$2 CMAX=$3
+	set -- `awk '{print $3}' "$TMP/times" | stats`
+	RMED=$1 RMIN=$2 RMAX=$3
+	SPREAD=`echo $RMED $RMIN $RMAX |
+	    awk '{ if ($1 > 0) printf "%.1f", ($3-$2)*100/$1; else print 0 }'`
+
+	printf >&2 "%-12s %-10s %-8s run %ss (%s%%) compile %ss\n" \
+	    $p $e $STATUS $RMED $SPREAD $CMED
+
+	echo "$p,$e,$BACKEND,$STATUS,$OPT,$CMED,$CMIN,$CMAX,$RMED,$RMIN,$RMAX,$SPREAD" >> "$CSV"
+	printf "$SEP" >> "$JSON"
+	printf '    {"program": "%s", "engine": "%s", "backend": "%s", "status": "%s", "opt_time": %s, "compile_time": {"median": %s, "min": %s, "max": %s}, "run_time": {"median": %s, "min": %s, "max": %s, "spread_pct": %s}}' \
+	    $p $e $BACKEND $STATUS $OPT $CMED $CMIN $CMAX \
+	    $RMED $RMIN $RMAX $SPREAD >> "$JSON"
+	SEP=',\n'
+    done
+done
+
+{
+    echo
+    echo "  ]"
+    echo "}"
+} >> "$JSON"
+
+echo >&2 "Results in $CSV and $JSON"
@@ -51,6 +51,7 @@ characters after your favorite comment marker in a very visible form.
 #include <unistd.h>
 #include <limits.h>
 #include <string.h>
+#include <errno.h>
 #if !defined(LEGACYOS) && _POSIX_VERSION >= 200112L
 #include <locale.h>
 #include <langinfo.h>
@@ -80,6 +81,14 @@ characters after your favorite comment marker in a very visible form.
 
 #ifndef NO_EXT_BE
 #include "clock.h"
+#include "outring.h"
+#include "perfcnt.h"
+#include "tracering.h"
+#include "jobserver.h"
+#include "libtritium.h"
+#include "batch.h"
+#include "autosel.h"
+#include "watchdog.h"
 
 enum codestyle { c_default,
 #define XX 1
@@ -95,6 +104,7 @@ const char * codestylename[] = { "std"
 #define finish_runclock(x,y)
 #define pause_runclock(x)
 #define unpause_runclock(x)
+#define wall_clock() 0.0
 static int * taperam = 0;
 #define map_hugeram() (void*)((taperam = tcalloc(memsize-hard_left_limit,sizeof(int)))-hard_left_limit)
 #define unmap_hugeram() free(taperam)
@@ -113,6 +123,9 @@ int opt_level = 2;
 int opt_runner = 0;
 int opt_no_calc = 0;
 int opt_no_litprt = 0;
+int opt_async_output = 0;
+int opt_perfcnt = 0;
+int opt_loop_counters = 0;
 int opt_no_endif = 0;
 int opt_no_kv_recursion = 0;
 int opt_no_loop_classify = 0;
@@ -128,6 +141,15 @@ int iostyle = 0; /* 0=ASCII, 1=UTF8, 2=Binary, 3=Integer. */
 int eofcell = 0; /* 0=>?, 1=> No Change, 2= -1, 3= 0, 4=EOF, 5=No Input, 6=Abort. */
 char * input_string = 0;
 char * program_string = 0;
+char * spec_input_file = 0;
+char * spec_input = 0;
+size_t spec_input_len = 0, spec_input_pos = 0;
+char * report_file = 0;
+char * trace_file = 0;
+char * trace_decode_file = 0;
+char * serve_socket = 0;
+char * serve_client = 0;
+unsigned long trace_records = 1UL<<20;
 int libc_allows_utf8 = 0;
 int default_io = 1;
 static int insane_ints = 0;
@@ -149,6 +171,15 @@ char const * cell_type = "C";	/* Cell C variable type */
 int cell_type_iso = 0;	/* Using uintmax_t or similar for above. */
 int only_uses_putch = 0;
 
+/*
+ * When stdout is fully buffered with a buffer of this size putch() and
+ * putstr() count the bytes and do the flush themselves just before stdio
+ * would. Only the flush is timed as I/O, not every character.
+ */
+#define OUTBUFSIZE  65536
+static size_t outbuf_used = 0, outbuf_size = 0;
+static char * outbuf = 0;
+
 const char * bfname = "brainfuck";
 int curr_line = 0, curr_col = 0;
 int cmd_line = 0, cmd_col = 0;
@@ -174,13 +205,31 @@ int most_neg_maad_loop = 0;
 double profile_hits = 0.0;
 int profile_min_cell = 0;
 int profile_max_cell = 0;
+unsigned long long * loop_counts = 0;
+static int loop_count_total = 0;
+static int * loop_linecol = 0;
+
+/* For --report */
+#define MAXPASSES 16
+static struct { const char * name; double time; int before, after; }
+    report_pass[MAXPASSES];
+static int report_passes = 0, report_nodes = 0;
+static const char * report_engine = 0;
+static double report_compile_time = 0;
+double output_bytes = 0, input_chars = 0;
 
 /* Reading */
 void load_file(FILE * ifd, int is_first, int is_last, char * bfstring);
-void process_file(void);
+void optimise_tree(void);
+void process_file(struct tritium * t);
+int process_args(int argc, char ** argv, const char ** filelist);
 
 /* Building */
 void print_tree_stats(void);
+void setup_loop_counters(void);
+void tree_loop_counters(void);
+void print_loop_counters(void);
+void write_report(void);
 void printtreecell(FILE * efd, int indent, struct bfi * n);
 void printtree(void);
 void calculate_stats(void);
@@ -217,7 +266,9 @@ void set_cell_size(int cell_bits);
 
 /* Trial run. */
 void try_opt_runner(void);
-int update_opt_runner(struct bfi * n, int * mem, int offset);
+#ifndef LIBTRITIUM
+static void load_spec_input(void);
+#endif
 
 /* Other functions. */
 void LongUsage(FILE * fd, const char * errormsg) __attribute__ ((__noreturn__));
@@ -244,7 +295,7 @@ void LongUsage(FILE * fd, const char * errormsg)
 	fprintf(fd, "   -z   End of file gives 0. -e=-1, -n=skip.\n");
 	if (insane_ints)
 	    fprintf(fd, "\nBEWARE: The C compiler does NOT use twos-complement arithmetic.\n");
-	exit(1);
+	fail_exit(1);
     }
 
     printf("    If the file is '-' this will read from the standard input and use\n"
@@ -285,7 +336,7 @@ void LongUsage(FILE * fd, const char * errormsg)
 #endif
     printf("   -H   Remove headers in output code\n");
     printf("        Also prevents optimiser assuming the tape starts blank.\n");
-    printf("   -#   Use '#' as a debug symbol. Note: Selects the tree interpreter.\n");
+    printf("   -#   Use '#' as a debug symbol, it prints the tape around the pointer.\n");
     printf("\n");
     printf("   -a   Ascii I/O, filters CR from input%s\n", iostyle==0?" (enabled)":"");
 #ifdef __STDC_ISO_10646__
@@ -299,6 +350,7 @@ void LongUsage(FILE * fd, const char * errormsg)
     printf("   -O2      Allow a few simple optimisations.\n");
     printf("   -O3      Maximum normal level, default.\n");
     printf("   -Orun    When generating code run the interpreter over it first.\n");
+    printf("            Any -I strings are read by this run, not the code.\n");
     printf("   -m   Turn off all optimisation and RLE.\n");
     printf("\n");
     printf("   -b   Use 8 bit cells.\n");
@@ -332,12 +384,79 @@ void LongUsage(FILE * fd, const char * errormsg)
     printf("   -fintio\n");
     printf("        Use decimal I/O instead of character I/O.\n");
     printf("        Specify before -b1 for cell sizes below 7 bits.\n");
+    printf("   --report=file.json\n");
+    printf("        Write the optimiser pass times, the backend used and the\n");
+    printf("        run statistics to the file as JSON.\n");
+    printf("   --spec-input=file\n");
+    printf("        The fixed start of the input; -Orun reads this and any -I\n");
+    printf("        strings while generating code and the code generated reads\n");
+    printf("        the rest of the input. Implies -Orun.\n");
+    printf("   --trace-file=file.trace\n");
+    printf("        Trace each node run into a ring of binary records in the\n");
+    printf("        file, using the array interpreter unless -T is also given.\n");
+    printf("   -trace-size N\n");
+    printf("        Keep the last N records in the ring (default 1M).\n");
+    printf("   --trace-decode=file.trace\n");
+    printf("        Print the records in a trace file like -T does and exit.\n");
+    printf("   --serve=socket\n");
+    printf("        Run BF programs sent to the Unix socket, keeping each\n");
+    printf("        program compiled for the next request with the same text.\n");
+    printf("        The other options are used for every program. A run is\n");
+    printf("        stopped by -loop-limit and -time-limit, or after a minute.\n");
+    printf("   --serve-client=socket\n");
+    printf("        Send the program and stdin to a --serve server and write\n");
+    printf("        the program's output to stdout.\n");
+    printf("   -floop-counters\n");
+    printf("        Count the entries to and iterations of each loop and list\n");
+    printf("        the busiest when the program ends.\n");
+#ifndef NO_EXT_BE
+    printf("   -fasync-output\n");
+    printf("        Write the program's output from a separate thread so a slow\n");
+    printf("        reader doesn't stop the program until 1MB is waiting.\n");
+    printf("   --batch=inputs.list\n");
+    printf("        Compile the program once then run it with each file named\n");
+    printf("        in the list as input, writing the output to file.out.\n");
+    printf("        Every run is a fork of the compiled program.\n");
+    printf("   -batch-jobs N\n");
+    printf("        Run N of the -batch jobs at once (default one per CPU).\n");
+    printf("   -fperf-counters\n");
+    printf("        Count CPU cycles, instructions and cache misses while the\n");
+    printf("        program runs using perf_event_open(), if it's permitted.\n");
+    printf("   -fauto-engine\n");
+    printf("        Choose the array interpreter, DynASM or C and the C -O level\n");
+    printf("        from the optimised program; use -v to see the choice.\n");
+    printf("   --auto-history=file\n");
+    printf("        Keep the times of each -fauto-engine run in the file and use\n");
+    printf("        them to choose the engine when the program is run again.\n");
+    printf("   -fwatchdog\n");
+    printf("        Stop with an error if the program goes round the same\n");
+    printf("        states forever without any I/O; the loop is named.\n");
+    printf("   -watchdog-interval N\n");
+    printf("        Loop back-edges between the watchdog checks (default 1M).\n");
+    printf("   -loop-limit N\n");
+    printf("        Stop with an error after N loop back-edges; k, M or G may\n");
+    printf("        be added to the number.\n");
+    printf("   -time-limit S\n");
+    printf("        Stop with an error if the program runs for S seconds.\n");
+    printf("        The watchdog and the limits are for the array interpreter\n");
+    printf("        and DynASM; without them the loops are not slowed at all.\n");
+#endif
     printf("   -mem %d\n", memsize);
     if (!huge_ram_available)
 	printf("        Define allocation size for tape memory.\n");
     else {
 	printf("        Define array size for generated code.\n");
 	printf("        The '-r' option always uses a huge array.\n");
+	printf("   -tapesize 2G\n");
+	printf("        Size of the huge array in bytes, may be larger than 2G.\n");
+	printf("        It is only committed as it's used.\n");
+	printf("   -fno-hugepage\n");
+	printf("        Don't ask for transparent huge pages for the huge array.\n");
+	printf("   -fhugetlb\n");
+	printf("        Use reserved (hugetlbfs) pages for the huge array if possible.\n");
+	printf("   -fprefault\n");
+	printf("        Fault in the part of the array that is expected to be used\n");
+	printf("        before the program starts. Use -v to see page fault counts.\n");
     }
     printf("\n");
     printf("Optimisation extras\n");
@@ -406,7 +525,7 @@ void LongUsage(FILE * fd, const char * errormsg)
     if (insane_ints)
 	printf("\nBEWARE: The C compiler does NOT use twos-complement arithmetic.\n");
 
-    exit(1);
+    fail_exit(1);
 }
 
 void
@@ -450,7 +569,7 @@ UsageInt64(void)
 	"The dc(1) generator can have unlimited size cells\n");
 #endif
 
-    exit(1);
+    fail_exit(1);
 }
 
 int
@@ -524,7 +643,7 @@ checkarg(char * opt, char * arg)
 		len += strlen(arg) + 2;
 		str = realloc(str, len);
 		if(!str) {
-		    perror("realloc"); exit(1);
+		    perror("realloc"); fail_exit(1);
 		}
 		if (!z) *str = 0;
 		strcat(str, arg);
@@ -540,6 +659,15 @@ checkarg(char * opt, char * arg)
     } else if (!strcmp(opt, "-Orun")) {
 	opt_runner = 1;
 	return 1;
+    } else if (!strncmp(opt, "-spec-input=", 12) && opt[12]) {
+	spec_input_file = opt+12;
+	opt_runner = 1;
+	return 1;
+    } else if (!strcmp(opt, "-spec-input")) {
+	if (arg == 0) return 0;
+	spec_input_file = arg;
+	opt_runner = 1;
+	return 2;
     } else if (!strcmp(opt, "-fno-negtape")) { hard_left_limit = 0; return 1;
     } else if (!strcmp(opt, "-fno-calctok")) { opt_no_calc = 1; return 1;
     } else if (!strcmp(opt, "-fno-endif")) { opt_no_endif = 1; return 1;
@@ -551,7 +679,157 @@ checkarg(char * opt, char * arg)
     } else if (!strcmp(opt, "-fno-loop-offset")) { opt_regen_mov = 1; return 1;
     } else if (!strcmp(opt, "-floop-offset")) { opt_regen_mov = 0; return 1;
     } else if (!strcmp(opt, "-fintio")) { iostyle = 3; opt_no_litprt = 1; default_io=0; return 1;
+    } else if (!strcmp(opt, "-floop-counters")) { opt_loop_counters = 1; return 1;
+    } else if (!strcmp(opt, "-fno-loop-counters")) { opt_loop_counters = 0; return 1;
+#ifndef NO_EXT_BE
+    } else if (!strcmp(opt, "-fhugepage")) { opt_hugepage = 1; return 1;
+    } else if (!strcmp(opt, "-fhugetlb")) { opt_hugepage = 2; return 1;
+    } else if (!strcmp(opt, "-fno-hugepage")) { opt_hugepage = 0; return 1;
+    } else if (!strcmp(opt, "-fprefault")) { opt_prefault = 1; return 1;
+    } else if (!strcmp(opt, "-fno-prefault")) { opt_prefault = 0; return 1;
+    } else if (!strcmp(opt, "-fasync-output")) { opt_async_output = 1; return 1;
+    } else if (!strcmp(opt, "-fno-async-output")) { opt_async_output = 0; return 1;
+    } else if (!strncmp(opt, "-batch=", 7) && opt[7]) {
+	batch_list = opt+7;
+	return 1;
+    } else if (!strcmp(opt, "-batch")) {
+	if (arg == 0) return 0;
+	batch_list = arg;
+	return 2;
+    } else if (!strcmp(opt, "-batch-jobs")) {
+	if (arg == 0 || (batch_workers = strtol(arg,0,10)) <= 0) {
+	    fprintf(stderr, "The -batch-jobs option needs a number.\n");
+	    fail_exit(1);
+	}
+	return 2;
+    } else if (!strcmp(opt, "-fperf-counters")) { opt_perfcnt = 1; return 1;
+    } else if (!strcmp(opt, "-fno-perf-counters")) { opt_perfcnt = 0; return 1;
+    } else if (!strcmp(opt, "-fauto-engine")) { opt_auto_engine = 1; return 1;
+    } else if (!strcmp(opt, "-fno-auto-engine")) { opt_auto_engine = 0; return 1;
+    } else if (!strncmp(opt, "-auto-history=", 14) && opt[14]) {
+	auto_history = opt+14;
+	opt_auto_engine = 1;
+	return 1;
+    } else if (!strcmp(opt, "-auto-history")) {
+	if (arg == 0) return 0;
+	auto_history = arg;
+	opt_auto_engine = 1;
+	return 2;
+    } else if (!strcmp(opt, "-fwatchdog")) { opt_watchdog = 1; return 1;
+    } else if (!strcmp(opt, "-fno-watchdog")) { opt_watchdog = 0; return 1;
+    } else if (!strcmp(opt, "-watchdog-interval") ||
+	       !strcmp(opt, "-loop-limit")) {
+	char * ep = "";
+	unsigned long long v = 0, mult = 1;
+	int big = 0;
+	if (arg && arg[0] >= '0' && arg[0] <= '9') {
+	    errno = 0;
+	    v = strtoull(arg, &ep, 10);
+	    big = (errno == ERANGE);
+	}
+	switch(*ep) {
+	case 'k': case 'K': mult = 1000; ep++; break;
+	case 'm': case 'M': mult = 1000000; ep++; break;
+	case 'g': case 'G': mult = 1000000000; ep++; break;
+	}
+	if (big || v > ~0ULL / mult) {
+	    fprintf(stderr, "The %s option's count is too large.\n", opt);
+	    fail_exit(1);
+	}
+	v *= mult;
+	if (v == 0 || *ep) {
+	    fprintf(stderr, "The %s option needs a count with an optional "
+			    "k, M or G suffix.\n", opt);
+	    fail_exit(1);
+	}
+	if (opt[1] == 'l')
+	    loop_limit = v;
+	else if (v > INT_MAX) {
+	    fprintf(stderr, "The %s option is limited to %d.\n", opt, INT_MAX);
+	    fail_exit(1);
+	} else
+	    watchdog_interval = (unsigned long)v;
+	return 2;
+    } else if (!strcmp(opt, "-time-limit")) {
+	char * ep = "";
+	if (arg) time_limit = strtod(arg, &ep);
+	if (!arg || ep == arg || *ep || time_limit <= 0) {
+	    fprintf(stderr, "The -time-limit option needs a number of seconds.\n");
+	    fail_exit(1);
+	}
+	return 2;
+    } else if (!strcmp(opt, "-tapesize")) {
+	char * ep = "";
+	unsigned long v = 0;
+	int shift = 0;
+	if (arg && arg[0] >= '0' && arg[0] <= '9')
+	    v = strtoul(arg, &ep, 10);
+	switch(*ep) {
+	case 'k': case 'K': shift = 10; ep++; break;
+	case 'm': case 'M': shift = 20; ep++; break;
+	case 'g': case 'G': shift = 30; ep++; break;
+	case 't': case 'T': shift = 40; ep++; break;
+	}
+	if (v == 0 || *ep || shift >= (int)sizeof(v)*CHAR_BIT ||
+		(v << shift >> shift) != v) {
+	    fprintf(stderr, "The -tapesize option needs a size in bytes "
+			    "with an optional K, M, G or T suffix.\n");
+	    fail_exit(1);
+	}
+	tape_mem_size = (size_t)(v << shift);
+	return 2;
+#endif
     } else if (!strcmp(opt, "-help")) { help_flag++; return 1;
+    } else if (!strncmp(opt, "-report=", 8) && opt[8]) {
+	report_file = opt+8;
+	return 1;
+    } else if (!strcmp(opt, "-report")) {
+	if (arg == 0) return 0;
+	report_file = arg;
+	return 2;
+    } else if (!strncmp(opt, "-trace-file=", 12) && opt[12]) {
+	trace_file = opt+12;
+	return 1;
+    } else if (!strcmp(opt, "-trace-file")) {
+	if (arg == 0) return 0;
+	trace_file = arg;
+	return 2;
+    } else if (!strncmp(opt, "-trace-decode=", 14) && opt[14]) {
+	trace_decode_file = opt+14;
+	return 1;
+    } else if (!strcmp(opt, "-trace-decode")) {
+	if (arg == 0) return 0;
+	trace_decode_file = arg;
+	return 2;
+    } else if (!strncmp(opt, "-serve=", 7) && opt[7]) {
+	serve_socket = opt+7;
+	return 1;
+    } else if (!strcmp(opt, "-serve")) {
+	if (arg == 0) return 0;
+	serve_socket = arg;
+	return 2;
+    } else if (!strncmp(opt, "-serve-client=", 14) && opt[14]) {
+	serve_client = opt+14;
+	return 1;
+    } else if (!strcmp(opt, "-serve-client")) {
+	if (arg == 0) return 0;
+	serve_client = arg;
+	return 2;
+    } else if (!strcmp(opt, "-trace-size")) {
+	char * ep = "";
+	unsigned long v = 0;
+	int shift = 0;
+	if (arg && arg[0] >= '0' && arg[0] <= '9')
+	    v = strtoul(arg, &ep, 10);
+	if (*ep == 'k' || *ep == 'K') { shift = 10; ep++; }
+	else if (*ep == 'm' || *ep == 'M') { shift = 20; ep++; }
+	if (v == 0 || *ep || v > (1UL<<27) >> shift) {
+	    fprintf(stderr, "The -trace-size option needs a number of "
+			    "records with an optional K or M suffix.\n");
+	    fail_exit(1);
+	}
+	trace_records = v << shift;
+	return 2;
     } else if (!strcmp(opt, "-mem")) {
 	if (arg == 0 || arg[0] < '0' || arg[0] > '9') {
 	    memsize = 30000;
@@ -570,13 +848,61 @@ checkarg(char * opt, char * arg)
     return 0;
 }
 
+/*
+ * Process the command line options; the other arguments are put into
+ * filelist and their count returned. If filelist is NULL they're errors.
+ */
+int
+process_args(int argc, char ** argv, const char ** filelist)
+{
+    int ar, opton=1, filecount = 0;
+    const char *p;
+
+    for(ar=1; ar<argc; ar++) {
+	if (opton && argv[ar][0] == '-' && argv[ar][1] != 0) {
+	    char optbuf[4];
+	    int f;
+	    if (argv[ar][1] == '-' && argv[ar][2] == 0) {
+		opton = 0;
+		continue;
+	    }
+	    if (argv[ar+1] && argv[ar+1][0] != '-')
+		f = checkarg(argv[ar], argv[ar+1]);
+	    else
+		f = checkarg(argv[ar], 0);
+	    if (f == 1) continue;
+	    if (f == 2) { ar++; continue; }
+
+	    optbuf[0] = '-';
+	    optbuf[1] = argv[ar][1];
+	    optbuf[2] = 0;
+	    if ((f = checkarg(optbuf, argv[ar]+2)) == 2) continue;
+
+	    for(p=argv[ar]+1+(f==1); *p; p++) {
+		optbuf[0] = '-';
+		optbuf[1] = *p;
+		optbuf[2] = 0;
+
+		if (checkarg(optbuf, 0) != 1)
+		    UsageOptError(argv[ar]);
+	    }
+	} else if (filelist)
+	    filelist[filecount++] = argv[ar];
+	else
+	    UsageOptError(argv[ar]);
+    }
+
+    return filecount;
+}
+
+#ifndef LIBTRITIUM
 int
 main(int argc, char ** argv)
 {
-    int ar, opton=1;
     const char *p;
     const char ** filelist = 0;
     int filecount = 0;
+    struct tritium * t;
 
     program = argv[0];
     if ((p=strrchr(program, '/')) != 0)
@@ -616,41 +942,23 @@ main(int argc, char ** argv)
 #endif
 
     filelist = calloc(argc, sizeof*filelist);
+    if ((t = tritium_command(argc, argv, filelist, &filecount)) == 0)
+	exit(1);
 
-    for(ar=1; ar<argc; ar++) {
-	if (opton && argv[ar][0] == '-' && argv[ar][1] != 0) {
-	    char optbuf[4];
-	    int f;
-	    if (argv[ar][1] == '-' && argv[ar][2] == 0) {
-		opton = 0;
-		continue;
-	    }
-	    if (argv[ar+1] && argv[ar+1][0] != '-')
-		f = checkarg(argv[ar], argv[ar+1]);
-	    else
-		f = checkarg(argv[ar], 0);
-	    if (f == 1) continue;
-	    if (f == 2) { ar++; continue; }
-
-	    optbuf[0] = '-';
-	    optbuf[1] = argv[ar][1];
-	    optbuf[2] = 0;
-	    if ((f = checkarg(optbuf, argv[ar]+2)) == 2) continue;
+    if(help_flag)
+	LongUsage(stdout, 0);
 
-	    for(p=argv[ar]+1+(f==1); *p; p++) {
-		optbuf[0] = '-';
-		optbuf[1] = *p;
-		optbuf[2] = 0;
+    if(trace_decode_file)
+	exit(trace_decode(trace_decode_file));
 
-		if (checkarg(optbuf, 0) != 1)
-		    UsageOptError(argv[ar]);
-	    }
-	} else
-	    filelist[filecount++] = argv[ar];
+    if(serve_socket) {
+	if(filecount || program_string)
+	    Usage("Error: The --serve option doesn't take a program");
+	exit(jobserver(serve_socket));
     }
 
-    if(help_flag)
-	LongUsage(stdout, 0);
+    if(serve_client)
+	exit(jobclient(serve_client, filecount?filelist[0]:0, program_string));
 
     if(program_string) {
 	if(filecount)
@@ -664,13 +972,36 @@ main(int argc, char ** argv)
     }
 
 #ifndef NO_EXT_BE
+    /* The -fauto-engine choice is made once the program is optimised. */
+    if (opt_auto_engine) {
+	if (do_run == -1 && do_codestyle == c_default)
+	    do_run = 1;
+	else
+	    opt_auto_engine = 0;	/* The engine was given */
+    }
+
 #define XX 4
 #include "bfi.be.def"
 
     if (do_run == -1) do_run = (do_codestyle == c_default);
+
+    if (trace_file && (do_codestyle != c_default || !do_run))
+	Usage("Error: Only the interpreters can write a binary trace");
+
+    if (batch_list) {
+	if (!do_run || trace_file || report_file)
+	    Usage("Error: The -batch option only runs the program");
+	if (filecount == 1 && !strcmp(filelist[0], "-"))
+	    Usage("Error: The -batch program cannot be read from stdin");
+	opt_async_output = 0;
+	opt_perfcnt = 0;
+    }
 #endif
 
+    if (spec_input_file && do_run)
+	Usage("Error: The --spec-input option is for generating code");
     if (do_run) opt_runner = 0; /* Run it in one go */
+    if (opt_runner) load_spec_input();
     if (cell_length==0 && (do_run || opt_runner))
 	set_cell_size(-1);
 
@@ -682,30 +1013,17 @@ main(int argc, char ** argv)
     if (filecount == 1 && strcmp(filelist[0], "-"))
 	bfname = filelist[0];	/* From argv */
 
-    for(ar = 0; ar<filecount; ar++) {
-	FILE * ifd;
-	const char * fname = filelist[ar];
-
-	if (!fname || strcmp(fname, "-") == 0) ifd = stdin;
-	else if ((ifd = fopen(fname, "r")) == 0) {
-	    perror(fname);
-	    exit(1);
-	}
-
-	load_file(ifd, ar==0, ar+1>=filecount, 0);
-
-	if (ifd!=stdin) fclose(ifd);
-    }
+    if (!tritium_load(t, filelist, filecount, program_string))
+	exit(1);
     free(filelist); filelist = 0;
 
-    if(program_string)
-	load_file(0, 1, 1, program_string);
-
-    process_file();
+    process_file(t);
 
     delete_tree();
+    tritium_delete(t);
     exit(0);
 }
+#endif
 
 /*
  * Load a file into the tree.
@@ -833,6 +1151,19 @@ static int dld, inp, rle = 0, num = 1;
     total_nodes = loaded_nodes;
 }
 
+/*
+ * An error in the options or the program. Inside libtritium the hook is
+ * set and returns the error from the library call instead of exiting.
+ */
+void (*fail_hook)(void) = 0;
+
+void
+fail_exit(int status)
+{
+    if (fail_hook) fail_hook();
+    exit(status);
+}
+
 void *
 tcalloc(size_t nmemb, size_t size)
 {
@@ -846,7 +1177,7 @@ tcalloc(size_t nmemb, size_t size)
     fprintf(stderr, "Allocate of %lu*%lu bytes failed, ABORT\n",
 	    (unsigned long)nmemb, (unsigned long)size);
 #endif
-    exit(42);
+    fail_exit(42);
 }
 
 struct bfi *
@@ -983,15 +1314,45 @@ printtree(void)
     fprintf(stderr, "End of whole tree dump.\n");
 }
 
+static int
+count_nodes(void)
+{
+    struct bfi * n;
+    int c = 0;
+    for(n=bfprog; n; n=n->next) c++;
+    return c;
+}
+
+static void
+add_report_pass(const char * name, double t)
+{
+    if (report_passes >= MAXPASSES) return;
+    if (!strncmp(name, "Time for ", 9)) name += 9;
+    report_pass[report_passes].name = name;
+    report_pass[report_passes].time = t;
+    report_pass[report_passes].before = report_nodes;
+    report_pass[report_passes].after = count_nodes();
+    report_passes++;
+}
+
+/*
+ * Run the optimiser over the loaded tree; the program is then ready for
+ * any of the engines or code generators.
+ */
 void
-process_file(void)
+optimise_tree(void)
 {
-#define tickstart() start_runclock()
+#define tickstart() do{ \
+	    if (report_file) report_nodes = count_nodes();	\
+	    start_runclock();					\
+	} while(0)
 #define tickend(str) do{ \
-	    if (verbose>2) {					\
+	    if (verbose>2 || report_file) {			\
 		double rt = 0;					\
 		finish_runclock(&rt,0);				\
-		if(rt) fprintf(stderr, str " %.3fs\n",rt);	\
+		if(rt && verbose>2)				\
+		    fprintf(stderr, str " %.3fs\n",rt);	\
+		if (report_file) add_report_pass(str, rt);	\
 	    } } while(0)
 
     if (verbose>5) printtree();
@@ -1058,58 +1419,146 @@ process_file(void)
     if (node_type_counts[T_MOV] == 0 && max_pointer >= 0)
 	memsize = max_pointer+1;
 
+#undef tickstart
+#undef tickend
+}
+
+#ifndef NO_EXT_BE
+/* Set the engine for -fauto-engine; the tree interpreter cases are kept. */
+static void
+choose_engine(void)
+{
+    unsigned avail = 1U << auto_array;
+    int e;
+
+    if (verbose>2 || enable_trace || trace_file ||
+	    total_nodes == node_type_counts[T_CHR])
+	return;
+
+#ifndef DISABLE_DYNASM
+    if (dynasm_ok && checkcell_dynasm())
+	avail |= 1U << auto_dynasm;
+#endif
+#if !defined(DISABLE_DLOPEN) && !defined(DISABLE_RUNC)
+    if (cell_length == 0 || !!strcmp(cell_type, "C"))
+	avail |= (1U << auto_cc0) | (1U << auto_cc1) | (1U << auto_cc2);
+#endif
+
+    switch(e = auto_choose(avail)) {
+#ifndef DISABLE_DYNASM
+    case auto_dynasm:
+	do_codestyle = c_dynasm;
+	break;
+#endif
+    case auto_cc0: case auto_cc1: case auto_cc2:
+	do_codestyle = c_ccode;
+	ccode_opt = e - auto_cc0;
+	break;
+    }
+}
+#endif
+
+void
+process_file(struct tritium * t)
+{
+    double backend_start = 0;
+
+    if (!tritium_optimise(t))
+	exit(1);
+    backend_start = wall_clock();
+
 #ifdef NO_EXT_BE
     if (do_run) {
+	if (trace_file && !trace_open(trace_file, trace_records, 0))
+	    exit(1);
+	report_engine = "tree";
 	run_tree();
 	if (verbose>2) {
 	    print_tree_stats();
 	    printtree();
 	}
 	unmap_hugeram();
+	trace_close();
     } else
 	print_codedump();
 #else
+    if (do_run && opt_auto_engine && do_codestyle == c_default)
+	choose_engine();
+
     if (do_run) {
 	if (total_nodes == node_type_counts[T_CHR])
 	    do_codestyle = c_default; /* Be lazy for a 'Hello World'. */
 	else if (isatty(STDOUT_FILENO))
 	    setbuf(stdout, 0);
+	else if (!outbuf && (outbuf = malloc(OUTBUFSIZE)) != 0) {
+	    /* Glibc ignores the size unless we give it the buffer. */
+	    if (setvbuf(stdout, outbuf, _IOFBF, OUTBUFSIZE) == 0)
+		outbuf_size = OUTBUFSIZE;
+	}
+
+	if (opt_async_output && !enable_trace && !debug_mode)
+	    if (!start_outring())
+		fprintf(stderr, "Asynchronous output is not available.\n");
+
+	if (opt_perfcnt && !perfcnt_open())
+	    fprintf(stderr, "Performance counters are not available.\n");
+
+	/* The -batch jobs are forked when the run is about to start. */
+	if (batch_list)
+	    runclock_hook = batch_start;
     }
 
+    if (do_run && opt_loop_counters)
+	setup_loop_counters();
+
     if (do_codestyle == c_default) {
 	if (do_run) {
-	    if (verbose>2 || debug_mode || enable_trace ||
+	    if (verbose>2 || enable_trace ||
+		(trace_file && cell_size <= 0) ||
 		total_nodes == node_type_counts[T_CHR]) {
 
 		if (total_nodes != node_type_counts[T_CHR] && cell_size <= 0) {
 		    fprintf(stderr, "ERROR: cannot run combination: "
 				    "%dbit cells%s%s%s.\n",
 			cell_length,
-			debug_mode? ", debug mode":"",
 			enable_trace? ", trace mode":"",
+			trace_file? ", binary trace":"",
 			verbose>2 ? ", profiling enabled":"");
 		    exit(1);
 		}
 
+		if (trace_file && !trace_open(trace_file, trace_records, 0))
+		    exit(1);
 		if (verbose)
 		    fprintf(stderr, "Starting profiling interpreter\n");
+		report_engine = "tree";
+		if (total_nodes != node_type_counts[T_CHR])
+		    watchdog_missing(report_engine);
 		run_tree();
+		tree_loop_counters();
 
 		if (verbose>2) {
 		    print_tree_stats();
 		    printtree();
 		}
-	    } else if (cell_size <= 0) {
+	    } else if (!checkcell_runarray()) {
 		if (verbose>1)
 		    fprintf(stderr, "Starting maxtree interpreter\n");
+		report_engine = "maxtree";
+		watchdog_missing(report_engine);
 		run_maxtree();
 	    } else {
+		if (trace_file && !trace_open(trace_file, trace_records, 1))
+		    exit(1);
 		if (verbose)
 		    fprintf(stderr, "Starting array interpreter\n");
+		report_engine = "array";
 		convert_tree_to_runarray();
 	    }
 
 	    unmap_hugeram();
+	    stop_outring();
+	    trace_close();
 	} else
 	    print_codedump();
     } else {
@@ -1118,6 +1567,11 @@ process_file(void)
 	    if (verbose)
 		fprintf(stderr, "Running tree using '%s' generator\n",
 			codestylename[do_codestyle]);
+	    report_engine = codestylename[do_codestyle];
+#ifndef DISABLE_DYNASM
+	    if (do_codestyle != c_dynasm)
+#endif
+		watchdog_missing(report_engine);
 
 	    switch(do_codestyle) {
 	    default:
@@ -1130,10 +1584,12 @@ process_file(void)
 	    }
 
 	    unmap_hugeram();
+	    stop_outring();
 	} else {
 	    if (verbose)
 		fprintf(stderr, "Generating '%s' style output code\n",
 			codestylename[do_codestyle]);
+	    report_engine = codestylename[do_codestyle];
 
 	    switch(do_codestyle) {
 	    default:
@@ -1148,6 +1604,23 @@ process_file(void)
     }
 #endif
 
+#ifndef NO_EXT_BE
+    if (runclock_hook) {
+	fprintf(stderr, "The -batch option is not available with the '%s' engine.\n",
+		report_engine);
+	exit(1);
+    }
+#endif
+
+    /* Everything the backend did that wasn't running the program. */
+    report_compile_time = wall_clock() - backend_start - run_time - io_time;
+    if (report_compile_time < 0) report_compile_time = 0;
+
+#ifndef NO_EXT_BE
+    if (do_run && opt_auto_engine)
+	auto_record(report_compile_time, run_time);
+#endif
+
     if (do_run && only_uses_putch == 2 && isatty(STDOUT_FILENO)) {
 	fflush(stdout);
 	fprintf(stderr, "\n");
@@ -1158,8 +1631,18 @@ process_file(void)
 	fprintf(stderr, "Run time %.6fs, I/O time %.6fs\n", run_time, io_time);
     }
 
-#undef tickstart
-#undef tickend
+    if (do_run && loop_counts)
+	print_loop_counters();
+
+#ifndef NO_EXT_BE
+    if (do_run && perfcnt_active) {
+	fflush(stdout);
+	perfcnt_report(profile_hits);
+    }
+#endif
+
+    if (report_file)
+	write_report();
 }
 
 void
@@ -1251,6 +1734,215 @@ print_tree_stats(void)
     }
 }
 
+/*
+ * Number the loops for -floop-counters, the engines that support it
+ * count into loop_counts[]. Only real loops get a number; a loop that
+ * has been turned into a T_MULT or an if isn't counted.
+ */
+void
+setup_loop_counters(void)
+{
+    struct bfi * n;
+    int id = 0;
+
+    for(n=bfprog; n; n=n->next)
+	if (n->type == T_WHL) id++;
+
+    loop_count_total = id;
+    loop_counts = tcalloc((size_t)id*2+2, sizeof*loop_counts);
+    loop_linecol = tcalloc((size_t)id*2+2, sizeof*loop_linecol);
+
+    id = 0;
+    for(n=bfprog; n; n=n->next)
+	if (n->type == T_WHL) {
+	    n->loopid = n->jmp->loopid = ++id;
+	    loop_linecol[id*2] = n->line;
+	    loop_linecol[id*2+1] = n->col;
+	}
+}
+
+/* The profiling interpreter already counts every node. */
+void
+tree_loop_counters(void)
+{
+    struct bfi * n;
+    if (!loop_counts) return;
+    for(n=bfprog; n; n=n->next)
+	if (n->type == T_WHL && n->loopid) {
+	    loop_counts[n->loopid*2] = (unsigned)n->profile;
+	    loop_counts[n->loopid*2+1] = (unsigned)n->jmp->profile;
+	}
+}
+
+static int
+cmp_loop_counts(const void * a, const void * b)
+{
+    unsigned long long ia = loop_counts[*(const int*)a*2+1];
+    unsigned long long ib = loop_counts[*(const int*)b*2+1];
+    if (ia != ib) return ia < ib ? 1 : -1;
+    return *(const int*)a - *(const int*)b;
+}
+
+void
+print_loop_counters(void)
+{
+    int * order;
+    int i, used = 0, shown;
+
+    order = tcalloc((size_t)loop_count_total+1, sizeof*order);
+    for(i=1; i<=loop_count_total; i++)
+	if (loop_counts[i*2])
+	    order[used++] = i;
+
+    if (used == 0) {
+	fprintf(stderr, "No loop counts were recorded by this interpreter.\n");
+	free(order);
+	return;
+    }
+    qsort(order, (size_t)used, sizeof*order, cmp_loop_counts);
+
+    shown = (verbose>1 || used <= 20) ? used : 20;
+    fprintf(stderr, "Loop counters, %d of %d loops run%s\n",
+	    used, loop_count_total, shown<used?", busiest 20":"");
+    fprintf(stderr, "%12s %14s %16s %12s\n",
+	    "line:col", "entries", "iterations", "avg trips");
+    for(i=0; i<shown; i++) {
+	int id = order[i];
+	char pos[32];
+	sprintf(pos, "%d:%d", loop_linecol[id*2], loop_linecol[id*2+1]);
+	fprintf(stderr, "%12s %14.0f %16.0f %12.2f\n", pos,
+		(double)loop_counts[id*2], (double)loop_counts[id*2+1],
+		(double)loop_counts[id*2+1] / (double)loop_counts[id*2]);
+    }
+    free(order);
+}
+
+static void
+json_string(FILE * fd, const char * s)
+{
+    putc('"', fd);
+    for(; *s; s++) {
+	if (*s == '"' || *s == '\\')
+	    fprintf(fd, "\\%c", *s);
+	else if ((unsigned char)*s < ' ')
+	    fprintf(fd, "\\u%04x", (unsigned char)*s);
+	else
+	    putc(*s, fd);
+    }
+    putc('"', fd);
+}
+
+static int
+cmp_profile(const void * a, const void * b)
+{
+    int pa = (*(struct bfi * const *)a)->profile;
+    int pb = (*(struct bfi * const *)b)->profile;
+    return (pa < pb) - (pa > pb);
+}
+
+/*
+ * The --report file. Keys are only ever added to this so scripts that
+ * read it keep working; times are in seconds.
+ */
+void
+write_report(void)
+{
+    FILE * fd;
+    struct bfi * n;
+    struct bfi ** hot = 0;
+    int i, c, nhot = 0;
+    double hits = 0;
+
+    if (strcmp(report_file, "-") == 0)
+	fd = stderr;
+    else if ((fd = fopen(report_file, "w")) == 0) {
+	perror(report_file);
+	return;
+    }
+
+    fprintf(fd, "{\n  \"report_version\": 1,\n  \"program\": ");
+    json_string(fd, bfname);
+    fprintf(fd, ",\n  \"cell_bits\": %u,\n  \"opt_level\": %d,\n",
+	    cell_length, opt_level);
+
+    fprintf(fd, "  \"nodes\": {\"loaded\": %d, \"total\": %d, \"types\": {",
+	    loaded_nodes, total_nodes);
+    for(c=0, i=0; i<TCOUNT; i++)
+	if (node_type_counts[i])
+	    fprintf(fd, "%s\"%s\": %d", c++?", ":"",
+		    tokennames[i], node_type_counts[i]);
+    fprintf(fd, "}},\n");
+
+    fprintf(fd, "  \"passes\": [");
+    for(i=0; i<report_passes; i++) {
+	fprintf(fd, "%s\n    {\"name\": ", i?",":"");
+	json_string(fd, report_pass[i].name);
+	fprintf(fd, ", \"time\": %.6f, \"nodes_before\": %d, \"nodes_after\": %d}",
+		report_pass[i].time, report_pass[i].before, report_pass[i].after);
+    }
+    fprintf(fd, "%s],\n", report_passes?"\n  ":"");
+
+    fprintf(fd, "  \"backend\": {\"name\": ");
+    json_string(fd, report_engine ? report_engine : "none");
+    fprintf(fd, ", \"run\": %s, \"compile_time\": %.6f},\n",
+	    do_run ? "true" : "false", report_compile_time);
+
+    fprintf(fd, "  \"run\": {\"time\": %.6f, \"io_time\": %.6f, "
+		"\"output_bytes\": %.0f, \"input_chars\": %.0f},\n",
+	    run_time, io_time, output_bytes, input_chars);
+
+    fprintf(fd, "  \"tape\": {\"offset_min\": %d, \"offset_max\": %d",
+	    min_pointer, max_pointer);
+    if (profile_min_cell != 0 || profile_max_cell != 0)
+	fprintf(fd, ", \"used_min\": %d, \"used_max\": %d",
+		profile_min_cell, profile_max_cell);
+    fprintf(fd, "}");
+
+    /* Only the profiling interpreter counts nodes. */
+    for(n=bfprog; n; n=n->next)
+	if (n->profile) { hits += n->profile; nhot++; }
+    if (nhot) {
+	hot = tcalloc((size_t)nhot, sizeof*hot);
+	for(nhot=0, n=bfprog; n; n=n->next)
+	    if (n->profile) hot[nhot++] = n;
+	qsort(hot, (size_t)nhot, sizeof*hot, cmp_profile);
+	fprintf(fd, ",\n  \"profile\": {\"hits\": %.0f, \"hot_nodes\": [", hits);
+	for(i=0; i<nhot && i<20; i++)
+	    fprintf(fd, "%s\n    {\"line\": %d, \"col\": %d, \"type\": \"%s\", "
+			"\"count\": %d}", i?",":"", hot[i]->line, hot[i]->col,
+			tokennames[hot[i]->type], hot[i]->profile);
+	fprintf(fd, "\n  ]}");
+	free(hot);
+    }
+
+    if (loop_counts) {
+	fprintf(fd, ",\n  \"loops\": [");
+	for(c=0, i=1; i<=loop_count_total; i++) {
+	    if (!loop_counts[i*2]) continue;
+	    fprintf(fd, "%s\n    {\"line\": %d, \"col\": %d, "
+			"\"entries\": %.0f, \"iterations\": %.0f}",
+		    c++?",":"", loop_linecol[i*2], loop_linecol[i*2+1],
+		    (double)loop_counts[i*2], (double)loop_counts[i*2+1]);
+	}
+	fprintf(fd, "%s]", c?"\n  ":"");
+    }
+
+#ifndef NO_EXT_BE
+    if (perfcnt_active) {
+	const char * name;
+	double v;
+	int rv;
+	fprintf(fd, ",\n  \"counters\": {");
+	for(c=0, i=0; (rv = perfcnt_get(i, &name, &v)) >= 0; i++)
+	    if (rv) fprintf(fd, "%s\"%s\": %.0f", c++?", ":"", name, v);
+	fprintf(fd, "}");
+    }
+#endif
+
+    fprintf(fd, "\n}\n");
+    if (fd != stderr) fclose(fd);
+}
+
 /*
  * This is a simple tree based interpreter with lots of instrumentation.
  *
@@ -1262,6 +1954,7 @@ run_tree(void)
 {
     int *p, *oldp;
     struct bfi * n = bfprog;
+    struct trace_rec * tr = 0;
 
     if (!opt_runner) only_uses_putch = 1;
 
@@ -1278,7 +1971,15 @@ run_tree(void)
 		if (off > profile_max_cell) profile_max_cell = off;
 	    }
 
-	    if (enable_trace) {
+	    if (trace_ring) {
+		TRACE_PUT(tr, n->inum, off, off >= 0 ? oldp[off] : 0);
+		if (n->type == T_CALC) {
+		    struct trace_rec * tc;
+		    TRACE_PUT(tc, TRACE_MORE, 0,
+			    n->count2 ? p[n->offset2] : 0);
+		    tc->nval = n->count3 ? p[n->offset3] : 0;
+		}
+	    } else if (enable_trace) {
 		fprintf(stderr, "P(%d,%d)=", n->line, n->col);
 		printtreecell(stderr, -1, n);
 		if (n->type == T_MOV)
@@ -1357,30 +2058,30 @@ run_tree(void)
 	    case T_INP:
 	    if (opt_runner) {
 		if (n->type == T_INP) {
-		    fprintf(stderr, "Error: Trial run optimise hit input command\n");
-		    exit(1);
-		} else {
-		    struct bfi *v = add_node_after(opt_run_end);
-		    v->type = T_CHR;
-		    v->line = n->line;
-		    v->col = n->col;
-		    v->count = UM(n->type == T_PRT?p[n->offset]:n->count);
-		    opt_run_end = v;
-		    if (opt_no_litprt) {
-			v->type = T_SET;
-			v = add_node_after(opt_run_end);
-			v->type = T_PRT;
-			v->line = n->line;
-			v->col = n->col;
-			opt_run_end = v;
+		    if (spec_input_pos >= spec_input_len) {
+			opt_runner_stop(n, oldp, (int)(p-oldp));
+			goto break_break;
 		    }
-		}
+		    p[n->offset] = (unsigned char)spec_input[spec_input_pos++];
+		} else
+		    opt_runner_chr(n->type == T_PRT?p[n->offset]:n->count,
+			    n->line, n->col);
 		break;
 	    } else {
 		switch(n->type)
 		{
 		case T_CHR:
-		    putch(n->count);
+		    if (enable_trace || trace_ring)
+			putch(n->count);
+		    else {
+			struct bfi * v = n;
+			n = putstr_nodes(n);
+			while (v != n) {
+			    v = v->next;
+			    v->profile++;
+			    node_profile_counts[T_CHR]++;
+			}
+		    }
 		    break;
 		case T_PRT:
 		    putch(p[n->offset]);
@@ -1403,22 +2104,9 @@ run_tree(void)
 		break;
 
 	    case T_DUMP:
-		if (!opt_runner) {
-		    int i, doff, off = (p+n->offset) - oldp;
-		    fflush(stdout); /* Keep in sequence if merged */
-		    fprintf(stderr, "P(%d,%d):", n->line, n->col);
-		    doff = off - 8;
-		    doff &= -4;
-		    if (doff <0) doff = 0;
-		    fprintf(stderr, "ptr=%d, mem[%d]= ", off, doff);
-		    for(i=0; i<16; i++) {
-			fprintf(stderr, "%s%s%d",
-					i?", ":"",
-					doff+i==off?">":"",
-					UM(oldp[doff+i]));
-		    }
-		    fprintf(stderr, "\n");
-		}
+		if (!opt_runner)
+		    tape_dump(n->line, n->col, oldp,
+			    (int)((p+n->offset) - oldp), (int)sizeof(*p));
 		break;
 
 	    case T_SUSP:
@@ -1434,7 +2122,9 @@ run_tree(void)
 			n->type, n->offset, n->count);
 		exit(1);
 	}
-	if (enable_trace && n->type != T_PRT && n->type != T_CHR && n->type != T_ENDIF) {
+	if (trace_ring && n->type != T_PRT && n->type != T_CHR && n->type != T_ENDIF) {
+	    tr->nval = p[n->offset];
+	} else if (enable_trace && n->type != T_PRT && n->type != T_CHR && n->type != T_ENDIF) {
 	    int off = (p+n->offset) - oldp;
 	    fflush(stdout); /* Keep in sequence if merged */
 	    fprintf(stderr, "P(%d,%d):", n->line, n->col);
@@ -1442,11 +2132,52 @@ run_tree(void)
 	}
 	n = n->next;
     }
+    if (opt_runner)
+	opt_runner_stop(0, oldp, (int)(p-oldp));
 
 break_break:;
     finish_runclock(&run_time, &io_time);
 }
 
+/*
+ * The '#' command, used by all the interpreters and backends that can run
+ * it. The tape starts at mem, the cells are csize bytes and the pointer
+ * is at cell off; sixteen cells around the pointer are printed.
+ */
+void
+tape_dump(int line, int col, const void * mem, int off, int csize)
+{
+    int i, doff;
+    fflush(stdout); /* Keep in sequence if merged */
+    fprintf(stderr, "P(%d,%d):", line, col);
+    doff = off - 8;
+    doff &= -4;
+    if (doff <0) doff = 0;
+    fprintf(stderr, "ptr=%d, mem[%d]= ", off, doff);
+    for(i=0; i<16; i++) {
+	fprintf(stderr, "%s%s", i?", ":"", doff+i==off?">":"");
+	switch(csize) {
+	case 1:
+	    fprintf(stderr, "%d", UM(((const unsigned char*)mem)[doff+i]));
+	    break;
+	case 2:
+	    fprintf(stderr, "%d", UM(((const unsigned short*)mem)[doff+i]));
+	    break;
+#if defined(ULLONG_MAX)
+	case 8: case 16:
+	    /* Only the low half of a 128 bit cell, it's little endian. */
+	    fprintf(stderr, "%llu",
+		*(const unsigned long long*)((const char*)mem+(doff+i)*csize));
+	    break;
+#endif
+	default:
+	    fprintf(stderr, "%d", UM(((const int*)mem)[doff+i]));
+	    break;
+	}
+    }
+    fprintf(stderr, "\n");
+}
+
 void
 delete_tree(void)
 {
@@ -1673,28 +2404,89 @@ pointer_regen(void)
 	    n->offset -= current_shift;
 	    break;
 
-	case T_PRT: case T_INP:
-	case T_CHR: case T_DUMP:
-	case T_ADD: case T_SET:
-	    n->offset -= current_shift;
-	    break;
+	case T_PRT: case T_INP:
+	case T_CHR: case T_DUMP:
+	case T_ADD: case T_SET:
+	    n->offset -= current_shift;
+	    break;
+
+	case T_CALC:
+	    n->offset -= current_shift;
+	    n->offset2 -= current_shift;
+	    n->offset3 -= current_shift;
+	    break;
+
+	case T_STOP:
+	case T_MOV:
+	    break;
+
+	default:
+	    fprintf(stderr, "Invalid node pointer regen = %s\n", tokennames[n->type]);
+	    fail_exit(1);
+	}
+	n = n->next;
+    }
+}
+
+/*
+ * Code generators that use 32 bit displacements can't reach a cell more
+ * than 2GB from the tape pointer; a tape that large is possible with
+ * -tapesize. Move all offsets into T_MOV nodes and move the pointer to
+ * any node that still refers to a far cell. Returns zero if there's a
+ * T_CALC that can't be fixed this way.
+ */
+int
+pointer_limit(int limit)
+{
+    struct bfi *v, *n;
+    int rv = 1, shift, save_regen = opt_regen_mov;
+
+    calculate_stats();
+    if (min_pointer >= -limit && max_pointer <= limit) return 1;
+
+    opt_regen_mov = 1;
+    pointer_regen();
+    opt_regen_mov = save_regen;
+
+    for(n = bfprog; n; n = n->next) {
+	switch(n->type)
+	{
+	case T_PRT: case T_INP: case T_DUMP:
+	case T_ADD: case T_SET: case T_CALC:
+	    if (n->offset >= -limit && n->offset <= limit &&
+		(n->type != T_CALC || (
+		    n->offset2 >= -limit && n->offset2 <= limit &&
+		    n->offset3 >= -limit && n->offset3 <= limit)))
+		break;
+
+	    shift = n->offset;
+	    if (n->prev)
+		v = add_node_after(n->prev);
+	    else {
+		v = add_node_after(0);
+		bfprog = v;
+	    }
+	    v->type = T_MOV;
+	    v->count = shift;
 
-	case T_CALC:
-	    n->offset -= current_shift;
-	    n->offset2 -= current_shift;
-	    n->offset3 -= current_shift;
-	    break;
+	    v = add_node_after(n);
+	    v->type = T_MOV;
+	    v->count = -shift;
 
-	case T_STOP:
-	case T_MOV:
+	    n->offset -= shift;
+	    if (n->type == T_CALC) {
+		n->offset2 -= shift;
+		n->offset3 -= shift;
+		if (n->offset2 < -limit || n->offset2 > limit ||
+		    n->offset3 < -limit || n->offset3 > limit)
+		    rv = 0;
+	    }
+	    n = v;
 	    break;
-
-	default:
-	    fprintf(stderr, "Invalid node pointer regen = %s\n", tokennames[n->type]);
-	    exit(1);
 	}
-	n = n->next;
     }
+    calculate_stats();
+    return rv;
 }
 
 void
@@ -3263,15 +4055,13 @@ build_string_in_tree(struct bfi * v)
  * For a good benchmark program this should do nothing, but frequently it'll
  * change the compiled program into a 'Hello World'.
  *
- * TODO: If there are NO T_INP instructions we could use a fast runner and
- *      just intercept the output.
+ * With a --spec-input the run reads it and carries on until the program
+ * wants more input, even if that's inside a loop; the program is then
+ * specialised for that input. For an interpreter written in BF that's
+ * given the program it interprets this is a compiled program.
  *
- *	I could continue running until we actually hit the T_INP instruction,
- *	I would need to save the current tape state so that it can be rolled
- *	back to the beginning of the loop.
- *
- *	This method could also be used in the middle of the program, just stop
- *	when you find a calculation based on an unknown.
+ * TODO: This method could also be used in the middle of the program, just
+ *	stop when you find a calculation based on an unknown.
  *
  *	A simple counter would stop this hanging on an infinite loop.
  */
@@ -3283,39 +4073,191 @@ try_opt_runner(void)
 
     if (cell_size <= 0) return;	/* Oops! */
 
-    while(v && v->type != T_INP && v->type != T_STOP) {
-	if (v->orgtype == T_END) lp--;
-	if(!lp && v->orgtype != T_WHL) n=v;
-	if (v->orgtype == T_WHL) lp++;
-	v=v->next;
-    }
+    if (spec_input_len == 0) {
+	while(v && v->type != T_INP && v->type != T_STOP) {
+	    if (v->orgtype == T_END) lp--;
+	    if(!lp && v->orgtype != T_WHL) n=v;
+	    if (v->orgtype == T_WHL) lp++;
+	    v=v->next;
+	}
 
-    if (n == 0) return;
+	if (n == 0) return;
 
-    if (verbose>5) {
-	fprintf(stderr, "Inserting T_SUSP node after: ");
-	printtreecell(stderr, 0, n);
-	fprintf(stderr, "\nSearch stopped by : ");
-	printtreecell(stderr, 0, v);
-	fprintf(stderr, "\n");
-    }
-    v = add_node_after(n);
-    v->type = T_SUSP;
+	if (verbose>5) {
+	    fprintf(stderr, "Inserting T_SUSP node after: ");
+	    printtreecell(stderr, 0, n);
+	    fprintf(stderr, "\nSearch stopped by : ");
+	    printtreecell(stderr, 0, v);
+	    fprintf(stderr, "\n");
+	}
+	v = add_node_after(n);
+	v->type = T_SUSP;
 
-    if (verbose>5) printtree();
+	if (verbose>5) printtree();
+    }
 
     opt_run_start = opt_run_end = tcalloc(1, sizeof*bfprog);
     opt_run_start->inum = bfi_num++;
     opt_run_start->type = T_NOP;
     if (verbose>3)
 	fprintf(stderr, "Running trial run optimise\n");
-    run_tree();
+    /* The tree is slow, but it counts for the stats. */
+    if (verbose>2 || enable_trace || !runarray_trial())
+	run_tree();
     if (verbose>2) {
 	fprintf(stderr, "Trial run optimise finished.\n");
+	if (spec_input_len)
+	    fprintf(stderr, "Specialised for %lu of %lu input bytes.\n",
+		(unsigned long)spec_input_pos, (unsigned long)spec_input_len);
 	print_tree_stats();
     }
 }
 
+#ifndef LIBTRITIUM
+/* The -spec-input file then the -I strings. */
+static void
+load_spec_input(void)
+{
+    FILE * fd;
+    size_t sz = 0;
+    int c;
+
+    if (spec_input_file) {
+	if ((fd = fopen(spec_input_file, "rb")) == 0) {
+	    perror(spec_input_file);
+	    exit(1);
+	}
+	while((c = getc(fd)) != EOF) {
+	    if (spec_input_len >= sz) {
+		sz = sz*2 + 4096;
+		if ((spec_input = realloc(spec_input, sz)) == 0) {
+		    perror("realloc"); exit(1);
+		}
+	    }
+	    spec_input[spec_input_len++] = (char)c;
+	}
+	fclose(fd);
+    }
+
+    if (input_string) {
+	size_t len = strlen(input_string);
+	if ((spec_input = realloc(spec_input, spec_input_len + len + 1)) == 0) {
+	    perror("realloc"); exit(1);
+	}
+	memcpy(spec_input + spec_input_len, input_string, len);
+	spec_input_len += len;
+	free(input_string);
+	input_string = 0;
+    }
+}
+#endif
+
+/*
+ * Copy the nodes from n to e onto the end of the list at *tailp; loops are
+ * linked to their copies with the jmp pointers. A T_WHL's count is its
+ * loop number, the copies get new ones above copy_lid.
+ */
+static int copy_lid;
+
+static void
+copy_nodes(struct bfi * n, struct bfi * e, struct bfi ** headp,
+	    struct bfi ** tailp)
+{
+    struct bfi * v, * s;
+
+    for(;;) {
+	v = tcalloc(1, sizeof*v);
+	*v = *n;
+	v->inum = bfi_num++;
+	v->profile = 0;
+	v->next = v->prevskip = v->jmp = 0;
+	v->prev = *tailp;
+	if (*tailp) (*tailp)->next = v; else *headp = v;
+	*tailp = v;
+
+	/* A loop start points at its original until its end is copied. */
+	if (n->type == T_END || n->type == T_ENDIF) {
+	    for(s = v->prev; s && s->jmp != n->jmp; s = s->prev) ;
+	    if (s) {
+		s->jmp = v;
+		v->jmp = s;
+	    }
+	} else if (n->type == T_WHL || n->type == T_IF ||
+		   n->type == T_MULT || n->type == T_CMULT) {
+	    v->jmp = n;
+	    if (n->type == T_WHL) v->count = ++copy_lid;
+	}
+
+	if (n == e) break;
+	n = n->next;
+    }
+}
+
+/*
+ * The trial run stopped at n, an input with no -spec-input left, or at the
+ * end of the program. The program goes on from n to the end of each loop
+ * that n is in, then runs the whole loop again while its cell is nonzero
+ * as its T_END would. So a new tree is made from copies of the rest of each
+ * loop's body each followed by the loop, and it replaces the program.
+ */
+void
+opt_runner_stop(struct bfi * n, int * mem, int offset)
+{
+    struct bfi * v, * head = 0, * tail = 0;
+
+    if (verbose>3)
+	fprintf(stderr, "Trial run optimise stopped for input.\n");
+
+    for(copy_lid = 0, v = bfprog; v; v = v->next)
+	if (v->type == T_WHL && v->count > copy_lid) copy_lid = v->count;
+
+    for(v = n; v; v = v->next) {
+	switch(v->type) {
+	case T_WHL: case T_IF: case T_MULT: case T_CMULT:
+	    copy_nodes(v, v->jmp, &head, &tail);
+	    v = v->jmp;
+	    break;
+
+	case T_END:
+	    /* The loop is entered where the T_END tests its cell. */
+	    copy_nodes(v->jmp, v, &head, &tail);
+	    tail->jmp->offset = v->offset;
+	    break;
+
+	case T_ENDIF: case T_SUSP:
+	    break;
+
+	default:
+	    copy_nodes(v, v, &head, &tail);
+	    break;
+	}
+    }
+
+    delete_tree();
+    bfprog = head;
+    update_opt_runner(bfprog, mem, offset);
+}
+
+/* Add a character the trial run printed to the new start of the program */
+void
+opt_runner_chr(int ch, int line, int col)
+{
+    struct bfi *v = add_node_after(opt_run_end);
+    v->type = T_CHR;
+    v->line = line;
+    v->col = col;
+    v->count = UM(ch);
+    opt_run_end = v;
+    if (opt_no_litprt) {
+	v->type = T_SET;
+	v = add_node_after(opt_run_end);
+	v->type = T_PRT;
+	v->line = line;
+	v->col = col;
+	opt_run_end = v;
+    }
+}
+
 int
 update_opt_runner(struct bfi * n, int * mem, int offset)
 {
@@ -3362,6 +4304,14 @@ update_opt_runner(struct bfi * n, int * mem, int offset)
     }
 
     if (bfprog) {
+	/* The printing used cell zero before the pointer moves. */
+	if (opt_no_litprt && opt_run_end != opt_run_start) {
+	    v = add_node_after(opt_run_end);
+	    v->type = T_SET;
+	    v->count = 0;
+	    opt_run_end = v;
+	}
+
 	for(i=profile_min_cell; i<=profile_max_cell; i++) {
 	    if (UM(mem[i]) != 0) {
 		v = add_node_after(opt_run_end);
@@ -3392,12 +4342,6 @@ update_opt_runner(struct bfi * n, int * mem, int offset)
     }
 
     if (opt_run_start) {
-	if (opt_no_litprt && bfprog) {
-	    struct bfi *v2 = add_node_after(opt_run_end);
-	    v2->type = T_SET;
-	    v2->count = 0;
-	    opt_run_end = v2;
-	}
 	opt_run_end->next = bfprog;
 	bfprog = opt_run_start;
 	if (opt_run_end->next)
@@ -3684,6 +4628,204 @@ print_codedump(void)
     printf("bf_end()\n");
 }
 
+/*
+ * UTF-8 without the locale; only used when the locale is UTF-8 anyway.
+ * Like glibc this allows the old five and six byte forms but not
+ * surrogates. Bad input bytes are skipped.
+ */
+static int
+utf8_getch(void)
+{
+    int ch, n, l, v;
+    for(;;) {
+	if ((ch = getchar()) < 0x80) return ch;
+	if (ch < 0xC0 || ch > 0xFD) continue;
+	n = l = ch>=0xFC?5: ch>=0xF8?4: ch>=0xF0?3: ch>=0xE0?2: 1;
+	v = ch & (0x3F>>n);
+	while (n && ((ch = getchar()) & 0xC0) == 0x80) {
+	    v = (v<<6) | (ch & 0x3F);
+	    n--;
+	}
+	if (n) { if (ch != EOF) ungetc(ch, stdin); continue; }
+	if (v < (l==1 ? 0x80 : 1<<(5*l+1))) continue;	/* Overlong */
+	if (v >= 0xD800 && v <= 0xDFFF) continue;
+	return v;
+    }
+}
+
+static size_t
+utf8_encode(char * buf, int ch)
+{
+    int n, i;
+    if (ch >= 0xD800 && ch <= 0xDFFF) return 0;
+    n = ch<0x800?2: ch<0x10000?3: ch<0x200000?4: ch<0x4000000?5: 6;
+    for(i=n-1; i>0; i--) {
+	buf[i] = (char) (0x80 | (ch & 0x3F));
+	ch >>= 6;
+    }
+    buf[0] = (char) ((0xFF00 >> n) | ch);
+    return (size_t)n;
+}
+
+/*
+ * Decimal I/O for -fintio without scanf() and printf().
+ */
+static const char digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324"
+    "25262728293031323334353637383940414243444546474849"
+    "50515253545556575859606162636465666768697071727374"
+    "75767778798081828384858687888990919293949596979899";
+
+/* Write 'v' backwards from 'e' with at least 'pad' digits */
+static char *
+fmt_dec(char * e, unsigned long v, int pad)
+{
+    char * p = e;
+    while (v >= 100) {
+	unsigned r = (unsigned)(v % 100) * 2;
+	v /= 100;
+	*--p = digit_pairs[r+1];
+	*--p = digit_pairs[r];
+    }
+    if (v >= 10) {
+	*--p = digit_pairs[v*2+1];
+	*--p = digit_pairs[v*2];
+    } else
+	*--p = (char) ('0' + v);
+    while (e-p < pad) *--p = '0';
+    return p;
+}
+
+static void
+putint(int ch)
+{
+    char buf[sizeof(int)*CHAR_BIT/3+4];
+    char * p = buf+sizeof(buf)-1;
+    *p = '\n';
+    if (ch < 0) {
+	p = fmt_dec(p, 0UL - (unsigned long)ch, 1);
+	*--p = '-';
+    } else
+	p = fmt_dec(p, (unsigned long)ch, 1);
+    putstr(p, (size_t)(buf+sizeof(buf)-p));
+}
+
+/*
+ * Larger cells are passed as an array of 16 bit words, least significant
+ * first, plus a sign. The words are used as scratch space.
+ */
+void
+putint_words(int neg, unsigned * w, int nw)
+{
+    char sbuf[64], *buf = sbuf, *p;
+    size_t sz = (size_t)nw * 5 + 3;
+    int i;
+
+    if (sz > sizeof(sbuf) && !(buf = malloc(sz))) {
+	perror("putint"); exit(1);
+    }
+    p = buf + sz - 1;
+    *p = '\n';
+
+    while (nw > 0 && w[nw-1] == 0) nw--;
+    while (nw > 1) {
+	unsigned long r = 0;
+	for(i=nw-1; i>=0; i--) {
+	    r = (r << 16) | w[i];
+	    w[i] = (unsigned) (r / 10000);
+	    r %= 10000;
+	}
+	p = fmt_dec(p, r, 4);
+	if (w[nw-1] == 0) nw--;
+    }
+    p = fmt_dec(p, nw ? w[0] : 0, 1);
+    if (neg) *--p = '-';
+
+    putstr(p, (size_t)(buf+sz-p));
+    if (buf != sbuf) free(buf);
+}
+
+/*
+ * Read a decimal number into 'nw' 16 bit words, the value wraps at the
+ * top. Returns zero if there's no number; like scanf() the character
+ * that stopped it is left in the input.
+ */
+static int
+scan_dec(int * neg, unsigned * w, int nw)
+{
+    int ch, i;
+
+    for(i=0; i<nw; i++) w[i] = 0;
+    *neg = 0;
+    do ch = getchar(); while (ch == ' ' || (ch >= '\t' && ch <= '\r'));
+    if (ch == '-' || ch == '+') {
+	*neg = (ch == '-');
+	ch = getchar();
+    }
+    if (ch < '0' || ch > '9') {
+	if (ch != EOF) ungetc(ch, stdin);
+	return 0;
+    }
+    do {
+	unsigned long c = (unsigned long) (ch - '0');
+	for(i=0; i<nw; i++) {
+	    c += (unsigned long) w[i] * 10;
+	    w[i] = (unsigned) (c & 0xFFFF);
+	    c >>= 16;
+	}
+    } while ((ch = getchar()) >= '0' && ch <= '9');
+    if (ch != EOF) ungetc(ch, stdin);
+    return 1;
+}
+
+static void
+input_wait(void)
+{
+    if (enable_trace || debug_mode) fflush(stdout);
+#ifndef NO_EXT_BE
+    flush_outring();
+#endif
+#ifdef _WIN32
+    fflush(stdout);
+#endif
+}
+
+/*
+ * Returns zero if the cell should not be changed, otherwise the number
+ * read or the EOF value is in 'neg' and 'w'.
+ */
+int
+getint_words(int * neg, unsigned * w, int nw)
+{
+    int i, rv;
+
+    if (input_string) {
+	int ch = getch(-256);
+	if (ch == -256) return 0;
+	*neg = (ch < 0);
+	if (ch < 0) ch = -ch;
+	for(i=0; i<nw; i++) { w[i] = (unsigned)ch & 0xFFFF; ch >>= 16; }
+	return 1;
+    }
+
+    pause_runclock();
+    input_wait();
+    rv = scan_dec(neg, w, nw);
+    unpause_runclock();
+    if (rv) { input_chars++; return 1; }
+
+    switch(eofcell)
+    {
+    case 2: case 4:
+	*neg = 1; w[0] = 1;
+	return 1;
+    case 3:
+	*neg = 0;
+	return 1;
+    default: return 0;
+    }
+}
+
 int
 getch(int oldch)
 {
@@ -3707,17 +4849,24 @@ getch(int oldch)
 	input_string = p;
     }
     else for(;;) {
-	if (enable_trace || debug_mode) fflush(stdout);
-#ifdef _WIN32
-	fflush(stdout);
-#endif
+	input_wait();
 	if (iostyle == 3) {
-	    int rv;
-	    rv = scanf("%d", &c);
-	    if (rv == EOF || rv == 0)
+	    unsigned w[(sizeof(int)*CHAR_BIT+15)/16];
+	    int neg, i;
+	    if (!scan_dec(&neg, w, (int)(sizeof(w)/sizeof(*w))))
 		c = EOF;
-	    else
-		c = UM(c);
+	    else {
+		unsigned v = 0;
+		for(i=(int)(sizeof(w)/sizeof(*w))-1; i>=0; i--)
+		    v = (v << 8 << 8) | w[i];
+		/* The number may be -1, so it's not checked against EOF */
+		unpause_runclock();
+		input_chars++;
+		return UM((int) (neg ? 0U-v : v));
+	    }
+	} else
+	if (iostyle == 1 && libc_allows_utf8) {
+	    c = utf8_getch();
 	} else
 #ifdef __STDC_ISO_10646__
 	if (iostyle == 1) {
@@ -3734,12 +4883,12 @@ getch(int oldch)
 #endif
 	    c = getchar();
 
-	if (iostyle != 2 && c == '\r') continue;
+	if (iostyle < 2 && c == '\r') continue;
 	break;
     }
     unpause_runclock();
 
-    if (c != EOF) return c;
+    if (c != EOF) { input_chars++; return c; }
     switch(eofcell)
     {
     case 2: return -1;
@@ -3749,10 +4898,37 @@ getch(int oldch)
     }
 }
 
+/*
+ * Returns true if 'len' more bytes will fit in the stdout buffer without
+ * stdio writing anything; flushes it first (as I/O time) if needed.
+ */
+static int
+outbuf_reserve(size_t len)
+{
+    if (!outbuf_size || len > outbuf_size) {
+	if (outbuf_used) {
+	    pause_runclock();
+	    fflush(stdout);
+	    unpause_runclock();
+	    outbuf_used = 0;
+	}
+	return 0;
+    }
+    if (outbuf_used + len > outbuf_size) {
+	pause_runclock();
+	fflush(stdout);
+	unpause_runclock();
+	outbuf_used = 0;
+    }
+    outbuf_used += len;
+    return 1;
+}
+
 void
 putch(int ch)
 {
-    pause_runclock();
+    int buffered;
+
 #ifdef __STDC_ISO_10646__
     if (iostyle == 1 && cell_mask>0 &&
        (cell_size > 21 || (cell_size == 21 && SM(ch) >= -128)))
@@ -3760,19 +4936,112 @@ putch(int ch)
     else
 #endif
 	ch = UM(ch);
+
     if (iostyle == 3) {
-	printf("%d\n", ch);
-    } else
+	putint(ch);
+	return;
+    }
+
+    if (ch > 127 && iostyle == 1 && libc_allows_utf8) {
+	char buf[8];
+	putstr(buf, utf8_encode(buf, ch));
+	return;
+    }
+
+#ifndef NO_EXT_BE
+    /* The writer thread does the waiting, so no clock calls. */
+    if (outring_active) {
 #ifdef __STDC_ISO_10646__
-    if (ch > 127 && iostyle == 1)
-	printf("%lc", ch);
-    else
+	if (ch > 127 && iostyle == 1) {
+	    char buf[MB_LEN_MAX];
+	    mbstate_t ps;
+	    size_t l;
+	    memset(&ps, 0, sizeof(ps));
+	    l = wcrtomb(buf, (wchar_t)ch, &ps);
+	    if (l != (size_t)-1) { outring_write(buf, l); output_bytes += l; }
+	} else
+#endif
+	{
+	    outring_putc(ch);
+	    output_bytes++;
+	}
+
+	if (only_uses_putch) only_uses_putch = 2-(ch == '\n');
+	return;
+    }
+#endif
+
+#ifdef __STDC_ISO_10646__
+    if (ch > 127 && iostyle == 1) {
+	int l;
+	buffered = outbuf_reserve(MB_LEN_MAX);
+	if (!buffered) pause_runclock();
+	l = printf("%lc", ch);
+	if (l > 0) output_bytes += l;
+    } else
 #endif
+    {
+	buffered = outbuf_reserve(1);
+	if (!buffered) pause_runclock();
 	putchar(ch);
+	output_bytes++;
+    }
+    if (!buffered) unpause_runclock();
 
     if (only_uses_putch) only_uses_putch = 2-(ch == '\n');
+}
 
-    unpause_runclock();
+/*
+ * Write a constant string in one call rather than a putch() for each
+ * character. The caller has checked every character with PUTSTR_CHAR()
+ * so the bytes go out exactly as putch() would have sent them.
+ */
+void
+putstr(const char * s, size_t len)
+{
+    if (len == 0) return;
+
+#ifndef NO_EXT_BE
+    if (outring_active)
+	outring_write(s, len);
+    else
+#endif
+    if (outbuf_reserve(len))
+	fwrite(s, 1, len, stdout);
+    else {
+	pause_runclock();
+	fwrite(s, 1, len, stdout);
+	unpause_runclock();
+    }
+    output_bytes += (double)len;
+
+    if (only_uses_putch) only_uses_putch = 2-(s[len-1] == '\n');
+}
+
+/*
+ * For the tree interpreters; print the run of T_CHR nodes starting at 'n'
+ * and return the last node printed.
+ */
+struct bfi *
+putstr_nodes(struct bfi * n)
+{
+    char buf[256];
+    size_t len = 0;
+
+    if (!PUTSTR_CHAR(n->count)) {
+	putch(n->count);
+	return n;
+    }
+
+    for(;;) {
+	buf[len++] = (char) /*GCC -Wconversion*/ n->count;
+	if (len >= sizeof(buf) || !n->next || n->next->type != T_CHR ||
+		!PUTSTR_CHAR(n->next->count))
+	    break;
+	n = n->next;
+    }
+    putstr(buf, len);
+    return n;
 }
 
 void
@@ -3845,7 +5114,7 @@ set_cell_size(int cell_bits)
     if (cell_size >= 0 && cell_size < 7 && iostyle != 3) {
 	fprintf(stderr, "A minimum cell size of 7 bits is needed for ASCII. "
 			"Add -fintio first.\n");
-	exit(1);
+	fail_exit(1);
     } else if (cell_size <= CHAR_BIT)
 	cell_type = "unsigned char";
     else if (cell_mask > 0 && cell_mask <= USHRT_MAX)
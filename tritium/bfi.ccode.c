@@ -51,6 +51,9 @@ static int in_one = 0;
 static int leave_temps = 0;
 #endif
 
+/* The C compiler's -O level for -fauto-engine, -1 is from the -O option. */
+int ccode_opt = -1;
+
 #ifndef DISABLE_TCCLIB
 void run_tccode(void);
 #endif
@@ -61,6 +64,8 @@ void run_gccode(void);
 static void pt(FILE* ofd, int indent, struct bfi * n);
 static char * pcell(int offset);
 static void print_c_header(FILE * ofd);
+static void print_lc_local(FILE * ofd);
+static int inner_loop(struct bfi * n);
 
 int
 checkarg_ccode(char * opt, char * arg)
@@ -161,6 +166,8 @@ print_c_header(FILE * ofd)
 {
     int memoffset = 0;
     int l_iostyle = iostyle;
+    int wide_intio = (iostyle == 3 && cell_size <= 0 &&
+			cell_length > sizeof(int)*CHAR_BIT);
 
     if (cell_mask > 0 && cell_size < 8 && l_iostyle == 1) l_iostyle = 0;
 
@@ -193,11 +200,6 @@ print_c_header(FILE * ofd)
 	}
     }
 
-    if (!do_run && node_type_counts[T_INP] != 0 && l_iostyle == 3) {
-	fprintf(stderr, "Standalone C code for integer input not implemented.\n");
-	exit(1);
-    }
-
     fprintf(ofd, "/* Code generated from %s */\n\n", bfname);
     fprintf(ofd, "#include <stdio.h>\n");
 
@@ -272,7 +274,7 @@ print_c_header(FILE * ofd)
     else
 	mask_defined = 0;
 
-    if (enable_trace || node_type_counts[T_DUMP] != 0) {
+    if (enable_trace || (node_type_counts[T_DUMP] != 0 && !do_run)) {
 	fprintf(ofd, "%s * imem;\n", cell_type);
 	fprintf(ofd, "%s%s%s%s%s\n",
 		    "static void prtnum(",cell_type," n) {"
@@ -312,7 +314,7 @@ print_c_header(FILE * ofd)
 	    "\n"    "}"
 	    "\n");
 
-	if (node_type_counts[T_DUMP] != 0)
+	if (node_type_counts[T_DUMP] != 0 && !do_run)
 	    fputs(  "#define t_dump(p4,p1,p2) trace('D',p1,p2,0,p4)\n", ofd);
 
 	if (enable_trace)
@@ -321,6 +323,10 @@ print_c_header(FILE * ofd)
 	fputs("\n", ofd);
     }
 
+    if (do_run && node_type_counts[T_DUMP] != 0)
+	fputs("#define t_dump(p4,p1,p2) "
+	      "tape_dump(p1,p2,mem,(int)((p4)-mem),(int)sizeof(*mem))\n\n", ofd);
+
     if (do_run) {
 	if (use_dlopen) {
 	    /* The structure defined in this chunk of code should be put into
@@ -328,34 +334,52 @@ print_c_header(FILE * ofd)
 	     * a string so it can be included into the generated code ...
 	     * TODO: configure make to do this.
 	     */
-	    fprintf(ofd, "%s%s%s%s%s\n",
+	    fprintf(ofd, "%s%s%s%s%s",
 		"typedef int (*runfnp)(void);\n"
 		"typedef int (*getfnp)(int ch);\n"
 		"typedef void (*putfnp)(int ch);\n"
+		"typedef void (*putsfnp)(const char * s, unsigned long len);\n"
+		"typedef void (*dumpfnp)(int l, int c, const void * m, int o, int s);\n"
 		"static int brainfuck(void);\n"
 		"struct bfinit {\n"
 		"  runfnp run; void *memptr; putfnp bf_putch; getfnp bf_getch;\n"
-		"} bf_init = {brainfuck,0,0,0};\n"
+		"  putsfnp bf_putstr; unsigned long long * loopcnt;\n"
+		"  dumpfnp bf_dump;\n"
+		"} bf_init = {brainfuck,0,0,0,0,0,0};\n"
+		"#define tape_dump (*bf_init.bf_dump)\n"
 		"#define mem ((", cell_type, "*)bf_init.memptr)\n"
 		"#define putch (*bf_init.bf_putch)\n"
 		"#define getch (*bf_init.bf_getch)\n"
+		"#define putstr (*bf_init.bf_putstr)\n"
 		"static int brainfuck(void){\n"
 		"  register ", cell_type, " * m = mem;\n");
+	    if (!use_functions) print_lc_local(ofd);
+	    fprintf(ofd, "\n");
 	} else {
 	    fprintf(ofd, "extern void putch(int ch);\n");
+	    fprintf(ofd, "extern void putstr(const char * s, unsigned long len);\n");
 	    fprintf(ofd, "extern int getch(int ch);\n");
 	    fprintf(ofd, "extern %s mem[];\n", cell_type);
+	    if (loop_counts)
+		fprintf(ofd, "extern unsigned long long lc[];\n");
+	    if (node_type_counts[T_DUMP] != 0)
+		fprintf(ofd, "extern void tape_dump(int l, int c, "
+			     "const void * m, int o, int s);\n");
 	    fprintf(ofd, "int main(){\n");
 	    fprintf(ofd, "  register %s * m = mem;\n", cell_type);
 	}
     }
     else
     {
-	if (node_type_counts[T_INP] != 0 || node_type_counts[T_PRT] != 0) {
+	if (node_type_counts[T_INP] != 0 || node_type_counts[T_PRT] != 0 ||
+		node_type_counts[T_CHR] != 0) {
 	    if (l_iostyle == 1) {
 		if (knr_c_ok) fprintf(ofd, "#if defined(__STDC__) && defined(__STDC_ISO_10646__)\n");
 		fprintf(ofd, "#include <locale.h>\n");
 		fprintf(ofd, "#include <wchar.h>\n");
+		fprintf(ofd, "#include <stdlib.h>\n");
+		fprintf(ofd, "#include <limits.h>\n");
+		fprintf(ofd, "static int utf8_io = 0;\n");
 		if (knr_c_ok) fprintf(ofd, "#endif\n");
 		fprintf(ofd, "\n");
 	    }
@@ -363,6 +387,74 @@ print_c_header(FILE * ofd)
 
 	if (node_type_counts[T_INP] != 0)
 	{
+	    if (l_iostyle == 1) {
+		if (knr_c_ok)
+		    fprintf(ofd, "#if defined(__STDC__) && defined(__STDC_ISO_10646__)\n");
+		fputs(
+		    "static int getu8(void)\n"
+		    "{\n"
+		    "  int ch, n, l, v;\n"
+		    "  for(;;) {\n"
+		    "\tif ((ch = getchar()) < 0x80) return ch;\n"
+		    "\tif (ch < 0xC0 || ch > 0xFD) continue;\n"
+		    "\tn = l = ch>=0xFC?5: ch>=0xF8?4: ch>=0xF0?3: ch>=0xE0?2: 1;\n"
+		    "\tv = ch & (0x3F>>n);\n"
+		    "\twhile (n && ((ch = getchar()) & 0xC0) == 0x80)\n"
+		    "\t    { v = (v<<6) | (ch & 0x3F); n--; }\n"
+		    "\tif (n) { if (ch != EOF) ungetc(ch, stdin); continue; }\n"
+		    "\tif (v < (l==1 ? 0x80 : 1<<(5*l+1))) continue;\n"
+		    "\tif (v >= 0xD800 && v <= 0xDFFF) continue;\n"
+		    "\treturn v;\n"
+		    "  }\n"
+		    "}\n", ofd);
+		if (knr_c_ok)
+		    fprintf(ofd, "#endif\n");
+		fprintf(ofd, "\n");
+	    }
+
+	    if (l_iostyle == 3 && !wide_intio) {
+		fputs(
+		    "static int getint(int * rv)\n"
+		    "{\n"
+		    "  int ch, neg = 0;\n"
+		    "  unsigned v = 0;\n"
+		    "  do ch = getchar(); while (ch == ' ' || (ch >= '\\t' && ch <= '\\r'));\n"
+		    "  if (ch == '-' || ch == '+') { neg = (ch == '-'); ch = getchar(); }\n"
+		    "  if (ch < '0' || ch > '9') {\n"
+		    "\tif (ch != EOF) ungetc(ch, stdin);\n"
+		    "\treturn 0;\n"
+		    "  }\n"
+		    "  do v = v*10 + (unsigned)(ch - '0');\n"
+		    "  while ((ch = getchar()) >= '0' && ch <= '9');\n"
+		    "  if (ch != EOF) ungetc(ch, stdin);\n"
+		    "  *rv = (int)(neg ? 0U-v : v);\n"
+		    "  return 1;\n"
+		    "}\n"
+		    "\n", ofd);
+	    }
+
+	    if (wide_intio) {
+		/* The whole cell, so it can't return EOF */
+		fprintf(ofd,
+		    "static %s getch(%s oldch)\n"
+		    "{\n"
+		    "  int ch, neg = 0;\n"
+		    "  %s v = 0;\n"
+		    "  do ch = getchar(); while (ch == ' ' || (ch >= '\\t' && ch <= '\\r'));\n"
+		    "  if (ch == '-' || ch == '+') { neg = (ch == '-'); ch = getchar(); }\n"
+		    "  if (ch < '0' || ch > '9') {\n"
+		    "\tif (ch != EOF) ungetc(ch, stdin);\n"
+		    "\treturn %s;\n"
+		    "  }\n"
+		    "  do v = v*10 + (unsigned)(ch - '0');\n"
+		    "  while ((ch = getchar()) >= '0' && ch <= '9');\n"
+		    "  if (ch != EOF) ungetc(ch, stdin);\n"
+		    "  return neg ? -v : v;\n"
+		    "}\n"
+		    "\n", cell_type, cell_type, cell_type,
+		    eofcell == 2 || eofcell == 4 ? "-1" :
+		    eofcell == 3 ? "0" : "oldch");
+	    } else
 	    if (l_iostyle == 2 && (eofcell == 4 || (eofcell == 2 && EOF == -1))) {
 		use_direct_getchar = 1;
 	    } else {
@@ -376,12 +468,16 @@ print_c_header(FILE * ofd)
 		fprintf(ofd, "  int ch;\n");
 		if (l_iostyle == 2) {
 		    fprintf(ofd, "  ch = getchar();\n");
+		} else if (l_iostyle == 3) {
+		    /* The number may be -1, so it's not checked against EOF */
+		    fprintf(ofd, "  if (getint(&ch)) return ch;\n");
+		    fprintf(ofd, "  ch = EOF;\n");
 		} else {
 		    fprintf(ofd, "  do {\n");
 		    if (l_iostyle == 1) {
 			if (knr_c_ok)
 			    fprintf(ofd, "#if defined(__STDC__) && defined(__STDC_ISO_10646__)\n");
-			fprintf(ofd, "\tch = getwchar();\n");
+			fprintf(ofd, "\tch = utf8_io ? getu8() : (int)getwchar();\n");
 			if (knr_c_ok) {
 			    fprintf(ofd, "#else\n");
 			    fprintf(ofd, "\tch = getchar();\n");
@@ -438,7 +534,12 @@ print_c_header(FILE * ofd)
 		    "#if defined(__STDC__) && defined(__STDC_ISO_10646__)\n"
 		    "static void putch(int ch)\n"
 		    "{\n"
-		    "  if(ch>127)\n"
+		    "  if(ch>127 && utf8_io) {\n"
+		    "\tint n = ch<0x800?2: ch<0x10000?3: ch<0x200000?4: ch<0x4000000?5: 6;\n"
+		    "\tif (ch >= 0xD800 && ch <= 0xDFFF) return;\n"
+		    "\tputchar((0xFF00>>n) | (ch>>(6*(n-1))));\n"
+		    "\twhile(--n) putchar(0x80 | ((ch>>(6*(n-1))) & 0x3F));\n"
+		    "  } else if(ch>127)\n"
 		    "\tprintf(\"%lc\",ch);\n"
 		    "  else\n"
 		    "\tputchar(ch);\n"
@@ -449,10 +550,32 @@ print_c_header(FILE * ofd)
 		    "\n", ofd);
 		break;
 	    case 3:
+		if (wide_intio) {
+		    /* Print the whole cell, signed */
+		    fprintf(ofd,
+			"static void putch(%s v)\n"
+			"{\n"
+			"  char buf[48], *p = buf+sizeof(buf);\n"
+			"  int neg = (v >> %u) != 0;\n"
+			"  if (neg) v = -v;\n"
+			"  *--p = '\\n';\n"
+			"  do *--p = (char)('0' + (int)(v%%10)); while ((v /= 10) != 0);\n"
+			"  if (neg) *--p = '-';\n"
+			"  fwrite(p, 1, (size_t)(buf+sizeof(buf)-p), stdout);\n"
+			"}\n"
+			"\n", cell_type, cell_length-1);
+		    break;
+		}
 		fputs(
 		    "static void putch(int ch)\n"
 		    "{\n"
-		    "  printf(\"%d\\n\", ch);\n"
+		    "  char buf[24], *p = buf+sizeof(buf);\n"
+		    "  unsigned v = ch;\n"
+		    "  if (ch < 0) v = -v;\n"
+		    "  *--p = '\\n';\n"
+		    "  do *--p = (char)('0' + v%10); while ((v /= 10) != 0);\n"
+		    "  if (ch < 0) *--p = '-';\n"
+		    "  fwrite(p, 1, (size_t)(buf+sizeof(buf)-p), stdout);\n"
 		    "}\n"
 		    "\n", ofd);
 		break;
@@ -545,17 +668,20 @@ print_c_header(FILE * ofd)
 	if (node_type_counts[T_INP] != 0) {
 	    fprintf(ofd, "  setbuf(stdout, 0);\n");
 	}
-	if (node_type_counts[T_INP] != 0 || node_type_counts[T_PRT] != 0)
+	if (node_type_counts[T_INP] != 0 || node_type_counts[T_PRT] != 0 ||
+		node_type_counts[T_CHR] != 0)
 	    if (l_iostyle == 1) {
 		if (knr_c_ok)
 		    fprintf(ofd, "#if defined(__STDC__) && defined(__STDC_ISO_10646__)\n");
 		fprintf(ofd, "  setlocale(LC_ALL, \"\");\n");
+		fprintf(ofd, "  { char b[MB_LEN_MAX]; utf8_io = "
+			     "wctomb(b, 0x20AC) == 3 && (b[0]&0xFF) == 0xE2; }\n");
 		if (knr_c_ok)
 		    fprintf(ofd, "#endif\n");
 	    }
     }
 
-    if (enable_trace || node_type_counts[T_DUMP] != 0) {
+    if (enable_trace || (node_type_counts[T_DUMP] != 0 && !do_run)) {
 	fprintf(ofd, "  imem = m;\n");
     }
 }
@@ -787,7 +913,10 @@ print_c_body(FILE* ofd, struct bfi * n, struct bfi * e)
 		    slen++;
 		    if (v->next && v->next->count == '\n')
 			;
-		    else if (slen > 132 || (slen>32 && v->count == '\n'))
+		    else if (do_run) {
+			/* No one reads this, so fewer bigger strings. */
+			if (slen > 4000) break;
+		    } else if (slen > 132 || (slen>32 && v->count == '\n'))
 			break;
 		}
 		p = s = malloc(slen);
@@ -809,6 +938,9 @@ print_c_body(FILE* ofd, struct bfi * n, struct bfi * e)
 
 		if ((p == s+1 && *s != '\'') || (p==s+2 && lastc == '\n')) {
 		    fprintf(ofd, "%s('%s');\n", putname, s);
+		} else if (do_run) {
+		    /* Our stdout and clock, not the stdio in the loaded code */
+		    fprintf(ofd, "putstr(\"%s\", %u);\n", s, i+1);
 		} else if (lastc == '\n') {
 		    *--p = 0; *--p = 0;
 		    fprintf(ofd, "puts(\"%s\");\n", s);
@@ -965,19 +1097,43 @@ print_c_body(FILE* ofd, struct bfi * n, struct bfi * e)
 		n=n->jmp;
 		break;
 	    }
+
+	    /* A count in each trip would be most of the run time of a rail
+	     * runner, so the trips are found from how far it moved. */
+	    if (found_rail_runner && n->loopid) {
+		pt(ofd, indent,n);
+		fprintf(ofd, "lc[%d]++;\n", n->loopid*2);
+		pt(ofd, indent,n);
+		fprintf(ofd, "{ register %s * lm = m; while(%s) m += %d; "
+			"lc[%d] += (m - lm) / %d; }\n",
+			cell_type, pcell(n->offset), n->next->count,
+			n->loopid*2+1, n->next->count);
+		n=n->jmp;
+		break;
+	    }
 	}
 
 	case T_CMULT:
 	case T_MULT:
+	    if (n->type == T_WHL && n->loopid) {
+		pt(ofd, indent,n);
+		fprintf(ofd, "lc[%d]++;\n", n->loopid*2);
+		if (inner_loop(n)) {
+		    pt(ofd, indent,n);
+		    fprintf(ofd, "{ register unsigned long long lk = 0;\n");
+		}
+	    }
 	    if (!use_goto) {
 		pt(ofd, indent,n);
 		fprintf(ofd, "while(%s) ", pcell(n->offset));
-		if (n->next->next && n->next->next->jmp == n && !enable_trace)
+		if (n->next->next && n->next->next->jmp == n && !enable_trace
+			&& !n->loopid)
 		    disable_indent = 1;
 		else
 		    fprintf(ofd, "{\n");
 	    } else {
-		if (n->next->next && n->next->next->jmp == n && !enable_trace) {
+		if (n->next->next && n->next->next->jmp == n && !enable_trace
+			&& !n->loopid) {
 		    disable_indent = 1;
 		    pt(ofd, indent,n);
 		    fprintf(ofd, "while(%s) ", pcell(n->offset));
@@ -997,6 +1153,13 @@ print_c_body(FILE* ofd, struct bfi * n, struct bfi * e)
 		disable_indent = 0;
 		break;
 	    }
+	    if (n->type == T_END && n->loopid) {
+		pt(ofd, indent+1,n);
+		if (inner_loop(n->jmp))
+		    fprintf(ofd, "lk++;\n");
+		else
+		    fprintf(ofd, "lc[%d]++;\n", n->loopid*2+1);
+	    }
 	    if (!use_goto) {
 		pt(ofd, indent,n);
 		fprintf(ofd, "}\n");
@@ -1010,6 +1173,10 @@ print_c_body(FILE* ofd, struct bfi * n, struct bfi * e)
 		    pt(ofd, indent,n);
 		fprintf(ofd, "E%d:;\n", n->jmp->count);
 	    }
+	    if (n->type == T_END && n->loopid && inner_loop(n->jmp)) {
+		pt(ofd, indent,n);
+		fprintf(ofd, "lc[%d] += lk; }\n", n->loopid*2+1);
+	    }
 	    break;
 
 	case T_STOP:
@@ -1053,6 +1220,31 @@ print_c_body(FILE* ofd, struct bfi * n, struct bfi * e)
     }
 }
 
+/*
+ * The -floop-counters array for a dlopen() run; in a local the pointer
+ * isn't loaded again after every store to the tape.
+ */
+static void
+print_lc_local(FILE * ofd)
+{
+    if (loop_counts && use_dlopen)
+	fprintf(ofd, "  register unsigned long long * lc = bf_init.loopcnt;\n");
+}
+
+/*
+ * An innermost loop counts its trips in a local; a store to the array on
+ * every trip can cost more than the loop.
+ */
+static int
+inner_loop(struct bfi * n)
+{
+    struct bfi * v;
+    for (v = n->next; v && v != n->jmp; v = v->next)
+	if (v->type == T_WHL)
+	    return 0;
+    return 1;
+}
+
 void
 print_ccode(FILE * ofd)
 {
@@ -1124,6 +1316,7 @@ print_ccode(FILE * ofd)
 	    else
 		fprintf(ofd, "%s * bf%d FD((register %s * m),(m) register %s * m;)\n{\n",
 		    cell_type, n->jmp->count, cell_type, cell_type);
+	    print_lc_local(ofd);
 	    print_c_body(ofd, n->jmp, n->next);
 	    fprintf(ofd, "  return m;\n}\n\n");
 
@@ -1139,6 +1332,7 @@ print_ccode(FILE * ofd)
 	fprintf(ofd, "void bf(register %s * m)\n{\n", cell_type);
     else
 	fprintf(ofd, "void bf FD((register %s * m),(m) register %s * m;)\n{\n", cell_type, cell_type);
+    print_lc_local(ofd);
     print_c_body(ofd, bfprog, (struct bfi *)0);
     fprintf(ofd, "}\n");
     return;
@@ -1156,6 +1350,8 @@ run_ccode(void)
 #else
     if (choose_runner >= 0)
 	use_dlopen = choose_runner;
+    else if (ccode_opt >= 0)
+	use_dlopen = 1;
     else
 #ifdef __TINYC__
 	use_dlopen = 0;
@@ -1205,6 +1401,8 @@ run_tccode(void)
     tcc_compile_string(s, ccode);
 
     tcc_add_symbol(s, "mem", memp);
+    if (loop_counts)
+	tcc_add_symbol(s, "lc", loop_counts);
 
     /* If our code was read from stdin it'll be done in standard mode,
      * the stdio stream is now modal (always a bad idea) so it's been switched
@@ -1221,9 +1419,15 @@ run_tccode(void)
     tcc_add_symbol(s, "getch", iso_workaround);
     *(void_func*) &iso_workaround  = (void_func) &putch;
     tcc_add_symbol(s, "putch", iso_workaround);
+    *(void_func*) &iso_workaround  = (void_func) &putstr;
+    tcc_add_symbol(s, "putstr", iso_workaround);
+    *(void_func*) &iso_workaround  = (void_func) &tape_dump;
+    tcc_add_symbol(s, "tape_dump", iso_workaround);
 #else
     tcc_add_symbol(s, "getch", &getch);
     tcc_add_symbol(s, "putch", &putch);
+    tcc_add_symbol(s, "putstr", &putstr);
+    tcc_add_symbol(s, "tape_dump", &tape_dump);
 
 #if defined(__TCCLIB_VERSION) && __TCCLIB_VERSION == 0x000925
 #define TCCDONE
@@ -1428,6 +1632,8 @@ run_gccode(void)
 typedef int (*runfnp)(void);
 typedef int (*getfnp)(int ch);
 typedef void (*putfnp)(int ch);
+typedef void (*putsfnp)(const char * s, size_t len);
+typedef void (*dumpfnp)(int l, int c, const void * m, int o, int s);
 
 static int loaddll(const char *);
 static runfnp runfunc;
@@ -1441,8 +1647,13 @@ compile_and_run(void)
     const char * cc = CC;
     const char * copt = "";
     const char * pic_cmd = "";
+    char optbuf[16];
     if (opt_level >= 3)
 	copt = " -O3";
+    if (ccode_opt >= 0) {
+	sprintf(optbuf, " -O%d", ccode_opt);
+	copt = optbuf;
+    }
 
     if (cc_cmd) cc = cc_cmd;
 
@@ -1528,6 +1739,9 @@ loaddll(const char * dlname)
     char *error;
     struct bfinit {
 	runfnp run; void *memptr; putfnp bf_putch; getfnp bf_getch;
+	putsfnp bf_putstr;
+	unsigned long long * loopcnt;
+	dumpfnp bf_dump;
     } *bf_init;
 
     if (verbose>4)
@@ -1562,6 +1776,9 @@ loaddll(const char * dlname)
     bf_init->memptr = map_hugeram();
     bf_init->bf_putch = putch;
     bf_init->bf_getch = getch;
+    bf_init->bf_putstr = putstr;
+    bf_init->loopcnt = loop_counts;
+    bf_init->bf_dump = tape_dump;
     runfunc = bf_init->run;
     if (verbose>4)
 	fprintf(stderr, "DLL loaded successfully\n");
@@ -6,5 +6,6 @@
 void run_ccode(void);
 void print_ccode(FILE * ofd);
 int checkarg_ccode(char * opt, char * arg);
+extern int ccode_opt;
 
 #endif
@@ -4,6 +4,7 @@
 
 void run_dynasm(void);
 int checkarg_dynasm(char * opt, char * arg);
+int checkcell_dynasm(void);
 extern int dynasm_ok;
 #define BE_DYNASM
 
@@ -35,6 +35,7 @@
 #endif
 
 #include "bfi.run.h"
+#include "bfi.runarray.h"
 #include "clock.h"
 
 #if defined(GNULIGHTv1) || defined(GNULIGHTv2)
@@ -89,12 +90,18 @@ static void
 clean_acc(void)
 {
     if (acc_loaded && acc_dirty) {
-	if (tape_step > 1) {
+	if (tape_step > 2) {
 	    if (acc_offset) {
 		jit_stxi_i(acc_offset * tape_step, REG_P, REG_ACC);
 	    } else {
 		jit_str_i(REG_P, REG_ACC);
 	    }
+	} else if (tape_step == 2) {
+	    if (acc_offset) {
+		jit_stxi_s(acc_offset * 2, REG_P, REG_ACC);
+	    } else {
+		jit_str_s(REG_P, REG_ACC);
+	    }
 	} else {
 	    if (acc_offset) {
 		jit_stxi_uc(acc_offset, REG_P, REG_ACC);
@@ -132,12 +139,18 @@ load_acc_offset(int offset)
     }
 
     acc_offset = offset;
-    if (tape_step > 1) {
+    if (tape_step > 2) {
 	if (acc_offset) {
 	    jit_ldxi_i(REG_ACC, REG_P, acc_offset * tape_step);
 	} else {
 	    jit_ldr_i(REG_ACC, REG_P);
 	}
+    } else if (tape_step == 2) {
+	if (acc_offset) {
+	    jit_ldxi_us(REG_ACC, REG_P, acc_offset * 2);
+	} else {
+	    jit_ldr_us(REG_ACC, REG_P);
+	}
     } else {
 	if (acc_offset) {
 	    jit_ldxi_uc(REG_ACC, REG_P, acc_offset);
@@ -151,7 +164,10 @@ load_acc_offset(int offset)
     acc_hi_dirty = (tape_step*8 != cell_size);
 }
 
-static void puts_without_nl(char * s) { fputs(s, stdout); }
+static void puts_without_nl(char * s)
+{
+    putstr(s, strlen(s));
+}
 
 static void failout(void) __attribute__ ((__noreturn__));
 static void failout(void) { fprintf(stderr, "STOP Command executed.\n"); exit(1); }
@@ -200,8 +216,18 @@ run_gnulightning(void)
 #endif
 
     if (cell_size == 8) tape_step = 1; else
+    if (cell_size == 16) tape_step = 2; else
     tape_step = sizeof(int);
 
+    if (!pointer_limit((INT_MAX-16)/tape_step)) {
+	if (verbose)
+	    fprintf(stderr, "WARNING: "
+			    "Tape offsets are too large for GNU Lightning, "
+			    "Switching to array interpreter.\n");
+	convert_tree_to_runarray();
+	return;
+    }
+
 #ifdef GNULIGHTv1
     /* TODO: Use mmap for allocating memory, the x86 execute protection
      * bit is on the segment so Linux has to say thay everything below
@@ -243,7 +269,7 @@ run_gnulightning(void)
 	    if (acc_loaded)
 		acc_offset -= n->count;
 
-	    jit_addi(REG_P, REG_P, n->count * tape_step);
+	    jit_addi(REG_P, REG_P, (long)n->count * tape_step);
 	    break;
 
 	case T_ADD:
@@ -289,8 +315,10 @@ run_gnulightning(void)
 
 		jit_movi(REG_ACC, n->count);
 		if (n->count2 != 0) {
-		    if (tape_step > 1)
+		    if (tape_step > 2)
 			jit_ldxi_i(REG_A1, REG_P, n->offset2 * tape_step);
+		    else if (tape_step == 2)
+			jit_ldxi_us(REG_A1, REG_P, n->offset2 * 2);
 		    else
 			jit_ldxi_uc(REG_A1, REG_P, n->offset2);
 		    if (n->count2 == -1)
@@ -302,8 +330,10 @@ run_gnulightning(void)
 	    }
 
 	    if (n->count3 != 0) {
-		if (tape_step > 1)
+		if (tape_step > 2)
 		    jit_ldxi_i(REG_A1, REG_P, n->offset3 * tape_step);
+		else if (tape_step == 2)
+		    jit_ldxi_us(REG_A1, REG_P, n->offset3 * 2);
 		else
 		    jit_ldxi_uc(REG_A1, REG_P, n->offset3);
 		if (n->count3 == -1)
@@ -329,7 +359,7 @@ run_gnulightning(void)
 		}
 	    }
 
-	    if (cell_mask > 0 && acc_hi_dirty) {
+	    if (cell_mask > 0 && acc_hi_dirty && tape_step*8 != cell_size) {
 		if (cell_mask == 0xFF)
 		    jit_extr_uc(REG_ACC,REG_ACC);
 		else
@@ -357,7 +387,7 @@ run_gnulightning(void)
 		exit(1);
 	    }
 
-	    if (cell_mask > 0 && acc_hi_dirty) {
+	    if (cell_mask > 0 && acc_hi_dirty && tape_step*8 != cell_size) {
 		if (cell_mask == 0xFF)
 		    jit_extr_uc(REG_ACC,REG_ACC);
 		else
@@ -411,7 +441,7 @@ run_gnulightning(void)
 	    clean_acc();
 	    acc_const = acc_loaded = 0;
 
-	    if (n->count <= 0 || (n->count >= 127 && iostyle == 1) ||
+	    if (!PUTSTR_CHAR(n->count) ||
 		    !n->next || n->next->type != T_CHR) {
 		jit_movi(REG_ACC, n->count);
 #ifdef GNULIGHTv1
@@ -428,10 +458,7 @@ run_gnulightning(void)
 		unsigned i = 0;
 		struct bfi * v = n;
 		char *s;
-		while(v->next && v->next->type == T_CHR &&
-			v->next->count > 0 &&
-			    (v->next->count < 127 || iostyle != 1)) {
-
+		for(;;) {
 		    if (i+2 > maxstrlen) {
 			if (maxstrlen) maxstrlen *= 2; else maxstrlen = 4096;
 			strbuf = realloc(strbuf, maxstrlen);
@@ -443,6 +470,9 @@ run_gnulightning(void)
 
 		    strbuf[i++] = (char) /*GCC -Wconversion*/ v->count;
 		    n = v;
+		    if (!v->next || v->next->type != T_CHR ||
+			    !PUTSTR_CHAR(v->next->count))
+			break;
 		    v = v->next;
 		}
 		strbuf[i] = 0;
@@ -2,16 +2,64 @@
 extern int verbose;
 extern int iostyle;
 extern int do_run;
+extern int opt_runner;
 
 extern double run_time, io_time;
+extern double output_bytes, input_chars;
 
 extern int huge_ram_available;
+extern int opt_hugepage, opt_prefault;
+extern size_t tape_mem_size;
 
 void run_tree(void);
 void * map_hugeram(void);
 void unmap_hugeram(void);
+size_t tape_span(char ** lo);
 void delete_tree(void);
 void * tcalloc(size_t nmemb, size_t size);
 
+/* The stages of main(), for libtritium. */
+int process_args(int argc, char ** argv, const char ** filelist);
+void load_file(FILE * ifd, int is_first, int is_last, char * bfstring);
+void optimise_tree(void);
+void set_cell_size(int cell_bits);
+extern void (*fail_hook)(void);
+void fail_exit(int status) __attribute__ ((__noreturn__));
+
 int getch(int oldch);
 void putch(int oldch);
+void putstr(const char * s, size_t len);
+void tape_dump(int line, int col, const void * mem, int off, int csize);
+
+/* The -Orun trial run, its input is -spec-input and any -I strings. */
+struct bfi;
+extern char * spec_input;
+extern size_t spec_input_len, spec_input_pos;
+int update_opt_runner(struct bfi * n, int * mem, int offset);
+void opt_runner_stop(struct bfi * n, int * mem, int offset);
+void opt_runner_chr(int ch, int line, int col);
+
+void putint_words(int neg, unsigned * w, int nw);
+int getint_words(int * neg, unsigned * w, int nw);
+
+/* -fintio for cells wider than an int; T is the unsigned cell type. */
+#define INTIO_NW(T) ((int)((sizeof(T)+1)/2))
+#define PUTINT_CELL(T, v, sgn) do {					\
+	T v_ = (v); unsigned w_[INTIO_NW(T)]; int i_, n_ = 0;		\
+	if ((sgn) && (v_ >> (sizeof(T)*8-1))) { n_ = 1; v_ = -v_; }	\
+	for(i_=0; i_<INTIO_NW(T); i_++) {				\
+	    w_[i_] = (unsigned)(v_ & 0xFFFF); v_ >>= 16;		\
+	}								\
+	putint_words(n_, w_, INTIO_NW(T));				\
+    } while(0)
+#define GETINT_CELL(T, lv) do {						\
+	unsigned w_[INTIO_NW(T)]; int i_, n_;				\
+	if (getint_words(&n_, w_, INTIO_NW(T))) {			\
+	    T v_ = 0;							\
+	    for(i_=INTIO_NW(T)-1; i_>=0; i_--) {			\
+		v_ <<= 16; v_ |= w_[i_];				\
+	    }								\
+	    if (n_) v_ = -v_;						\
+	    (lv) = v_;							\
+	}								\
+    } while(0)
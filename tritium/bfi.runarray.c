@@ -3,11 +3,19 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
+/* LLONG_MAX came in after inttypes.h, limits.h is very old. */
+#if _POSIX_VERSION >= 199506L || defined(LLONG_MAX)
+#include <inttypes.h>
+#endif
 
 #include "bfi.tree.h"
 #include "bfi.run.h"
 #include "bfi.runarray.h"
 #include "clock.h"
+#include "tracering.h"
+#include "libtritium.h"
+#include "watchdog.h"
 
 #ifndef MASK
 typedef int icell;
@@ -34,29 +42,108 @@ typedef int icell;
 #define DYNAMIC_MASK
 #endif
 
+/*
+ * Unless MASK fixes the cell type there are copies of the interpreter for
+ * the small cell types. Each tape uses the smallest C type that holds a
+ * cell; only cell sizes that don't exactly fill the type need masking.
+ * These copies only have the baseline ops, a program array with a T_STR
+ * or T_DUMP is run by run_progarray().
+ */
+#if defined(DYNAMIC_MASK) && !defined(DISABLE_RUNARRAY_NARROW)
+#if UCHAR_MAX == 0xFF
+#define RUNARRAY_8
+#endif
+#if USHRT_MAX == 0xFFFF
+#define RUNARRAY_16
+#endif
+#define RUNARRAY_INT
+#endif
+
+/* Cells larger than an int get their own copies of the interpreter. */
+#if defined(UINT64_MAX) && !defined(DISABLE_RUNARRAY_WIDE)
+#define RUNARRAY_64
+#endif
+#if defined(__SIZEOF_INT128__) && !defined(DISABLE_RUNARRAY_WIDE)
+#define RUNARRAY_128
+#endif
+
 static void run_progarray(int * p, icell * m);
+static void run_progarray_lc(int * p, icell * m);
+static unsigned long long * ra_loops;
+static void run_progarray_tr(int * p, icell * m);
+static int * ra_trace;
+static int ra_full;		/* The array has a T_STR or T_DUMP */
+static void run_progarray_io(int * p, icell * m, struct tritium_run * io,
+	icell * tape_lo, size_t tape_len, int io_mask, int io_eof);
+static void run_progarray_wd(int * p, icell * m);
+static struct wd_loop * ra_wdloop;
+static void run_watchdog(int * progarray);
+static void run_loop_counters(int * progarray);
+#ifdef DYNAMIC_MASK
+static void run_progarray_trial(int * p, icell * m);
+static struct {
+    icell * low, * high;	/* The cells used */
+    icell * m;			/* Where the run stopped */
+    int * p;
+} ra_trial;
+#endif
+#ifdef RUNARRAY_8
+static void run_progarray_8(int * p, unsigned char * m);
+static void run_progarray_8m(int * p, unsigned char * m);
+static void run_progarray_wd8(int * p, unsigned char * m);
+static void run_progarray_lc8(int * p, unsigned char * m);
+#endif
+#ifdef RUNARRAY_16
+static void run_progarray_16(int * p, unsigned short * m);
+static void run_progarray_16m(int * p, unsigned short * m);
+static void run_progarray_wd16(int * p, unsigned short * m);
+static void run_progarray_lc16(int * p, unsigned short * m);
+#endif
+#ifdef RUNARRAY_INT
+static void run_progarray_int(int * p, unsigned int * m);
+static void run_progarray_wdint(int * p, unsigned int * m);
+static void run_progarray_lcint(int * p, unsigned int * m);
+#endif
+#ifdef RUNARRAY_64
+static void run_progarray_64(int * p, uint64_t * m);
+#endif
+#ifdef RUNARRAY_128
+static void run_progarray_128(int * p, unsigned __int128 * m);
+#endif
 
-void
-convert_tree_to_runarray(void)
+/*
+ * Can the array interpreter run with the current cell size ?
+ */
+int
+checkcell_runarray(void)
+{
+    if (cell_size > 0) return 1;
+#ifdef RUNARRAY_64
+    if (cell_length == 64) return 1;
+#endif
+#ifdef RUNARRAY_128
+    if (cell_length == 128) return 1;
+#endif
+    return 0;
+}
+
+/*
+ * Build the program array from the tree; the tree is left alone. If
+ * loop_indexp is set the counts for -floop-counters and -trace-file are
+ * set up too. If nodesp is set it gets the node of each op by position.
+ */
+static int *
+build_runarray(size_t * arraylenp, int ** loop_indexp, struct bfi *** nodesp)
 {
     struct bfi * n = bfprog;
     size_t arraylen = 0;
     int * progarray = 0;
     int * p;
     int last_offset = 0;
-#ifndef DYNAMIC_MASK
-    if (cell_mask != MASK) {
-	if (verbose)
-	    fprintf(stderr, "Oops: Switching to profiling interpreter "
-			    "because the array interpreter has been\n"
-			    "configured with a fixed cell mask of 0x%x\n",
-			    MASK);
-	run_tree();
-	return;
-    }
-#endif
-    only_uses_putch = 1;
+    int * loop_index = 0;
+    struct bfi ** nodes = 0;
 
+    ra_full = 0;
     while(n)
     {
 	switch(n->type)
@@ -68,6 +155,10 @@ convert_tree_to_runarray(void)
 	    arraylen += 7;
 	    break;
 
+	case T_DUMP:
+	    arraylen += 4;
+	    break;
+
 	default:
 	    arraylen += 3;
 	    break;
@@ -76,13 +167,34 @@ convert_tree_to_runarray(void)
     }
 
     p = progarray = calloc(arraylen+2, sizeof*progarray);
-    if (!progarray) { perror("calloc"); exit(1); }
+    if (!progarray) { perror("calloc"); fail_exit(1); }
     n = bfprog;
 
+    /* The counts are kept by position in the array until the run ends. */
+    if (loop_indexp && loop_counts && cell_size > 0) {
+	ra_loops = tcalloc(arraylen+2, sizeof*ra_loops);
+	loop_index = tcalloc(arraylen+2, sizeof*loop_index);
+    }
+
+    if (nodesp)
+	nodes = tcalloc(arraylen+2, sizeof*nodes);
+
+    /* Tracing uses an op for every node so each record is for a node. */
+    if (loop_indexp && trace_ring && cell_size > 0) {
+	size_t i;
+	ra_trace = tcalloc(arraylen+2, sizeof*ra_trace);
+	for(i=0; i<arraylen+2; i++)
+	    ra_trace[i] = -2;
+	if (!ra_loops)
+	    ra_loops = tcalloc(arraylen+2, sizeof*ra_loops);
+    }
+
     last_offset = 0;
     while(n)
     {
 	if (n->type != T_MOV) {
+	    if (ra_trace) ra_trace[p-progarray] = n->inum;
+	    if (nodes) nodes[p-progarray] = n;
 	    *p++ = (n->offset - last_offset);
 	    last_offset = n->offset;
 	}
@@ -95,10 +207,32 @@ convert_tree_to_runarray(void)
 	*p++ = n->type;
 	switch(n->type)
 	{
-	case T_INP: case T_PRT:
+	case T_INP: case T_PRT: case T_SUSP:
+	    break;
+
+	case T_CHR:
+	    if (!ra_trace && PUTSTR_CHAR(n->count) && n->next && n->next->type == T_CHR &&
+		    PUTSTR_CHAR(n->next->count)) {
+		/* Pack the string into the array after its length */
+		char * s = (char*)(p+1);
+		int len = 0;
+		p[-1] = T_STR;
+		ra_full = 1;
+		for(;;) {
+		    s[len++] = (char) /*GCC -Wconversion*/ n->count;
+		    if (!n->next || n->next->type != T_CHR ||
+			    !PUTSTR_CHAR(n->next->count))
+			break;
+		    n = n->next;
+		}
+		*p++ = len;
+		p += (len + sizeof(int) - 1) / sizeof(int);
+		break;
+	    }
+	    *p++ = n->count;
 	    break;
 
-	case T_CHR: case T_ADD: case T_SET:
+	case T_ADD: case T_SET:
 	    *p++ = n->count;
 	    break;
 
@@ -112,7 +246,8 @@ convert_tree_to_runarray(void)
 	    /*FALLTHROUGH*/
 
 	case T_WHL:
-	    if (n->next->type == T_MOV && n->next->count != 0 && opt_level>=1){
+	    if (n->next->type == T_MOV && n->next->count != 0 && opt_level>=1 &&
+		    !ra_trace) {
 		/* Look for [<<<], [-<<<] and [-<<<+] */
 		struct bfi *n1, *n2=0, *n3=0, *n4=0;
 		n1 = n->next;
@@ -150,6 +285,9 @@ convert_tree_to_runarray(void)
 		}
 	    }
 
+	    if (loop_index && n->type == T_WHL && n->loopid)
+		loop_index[p-progarray-2] = n->loopid*2;
+
 	    /* Storing the location of the instruction in the T_END's count
 	     * field; it's not normally used */
 	    n->jmp->count = p-progarray;
@@ -162,6 +300,8 @@ convert_tree_to_runarray(void)
 	    break;
 
 	case T_END:
+	    if (loop_index && n->loopid)
+		loop_index[p-progarray-2] = n->loopid*2+1;
 	    progarray[n->count] = (p-progarray) - n->count;
 	    *p++ = -progarray[n->count];
 	    break;
@@ -202,47 +342,499 @@ convert_tree_to_runarray(void)
 	case T_STOP:
 	    break;
 
+	case T_DUMP:
+	    ra_full = 1;
+	    *p++ = n->line;
+	    *p++ = n->col;
+	    break;
+
 	default:
 	    fprintf(stderr, "Invalid node type found = %s\n", tokennames[n->type]);
-	    exit(1);
+	    fail_exit(1);
 	}
 	n = n->next;
     }
     *p++ = 0;
     *p++ = T_STOP;
 
+    if (loop_indexp) *loop_indexp = loop_index;
+    if (nodesp) *nodesp = nodes;
+    *arraylenp = arraylen;
+    return progarray;
+}
+
+void
+convert_tree_to_runarray(void)
+{
+    size_t arraylen = 0;
+    int * progarray = 0;
+    int * loop_index = 0;
+    struct bfi ** nodes = 0;
+#ifndef DYNAMIC_MASK
+    if (cell_size > 0 && cell_mask != MASK) {
+	if (verbose)
+	    fprintf(stderr, "Oops: Switching to profiling interpreter "
+			    "because the array interpreter has been\n"
+			    "configured with a fixed cell mask of 0x%x\n",
+			    MASK);
+	run_tree();
+	return;
+    }
+#endif
+    only_uses_putch = 1;
+
+    progarray = build_runarray(&arraylen, &loop_index,
+				watchdog_on() ? &nodes : 0);
+
+    /* The watchdog names a loop by its '[' */
+    if (nodes) {
+	if (ra_trace || ra_loops || cell_size <= 0)
+	    watchdog_missing("array");
+	else {
+	    size_t i;
+	    ra_wdloop = tcalloc(arraylen+2, sizeof*ra_wdloop);
+	    for(i=0; i<arraylen+2; i++)
+		if (nodes[i] && nodes[i]->type == T_END) {
+		    ra_wdloop[i].line = nodes[i]->jmp->line;
+		    ra_wdloop[i].col = nodes[i]->jmp->col;
+		}
+	    map_hugeram();
+	    watchdog_start();
+	}
+	free(nodes);
+    }
+
     delete_tree();
     start_runclock();
-    run_progarray(progarray, map_hugeram());
+    if (ra_wdloop)
+	run_watchdog(progarray);
+    else if (ra_trace)
+	run_progarray_tr(progarray, map_hugeram());
+    else if (ra_loops)
+	run_loop_counters(progarray);
+    else if (ra_full && cell_size > 0)
+	run_progarray(progarray, map_hugeram());
+    else
+#ifdef RUNARRAY_8
+    if (cell_size == 8)
+	run_progarray_8(progarray, map_hugeram());
+    else if (cell_size > 0 && cell_size < 8)
+	run_progarray_8m(progarray, map_hugeram());
+    else
+#endif
+#ifdef RUNARRAY_16
+    if (cell_size == 16)
+	run_progarray_16(progarray, map_hugeram());
+    else if (cell_size > 0 && cell_size < 16)
+	run_progarray_16m(progarray, map_hugeram());
+    else
+#endif
+#ifdef RUNARRAY_INT
+    if (cell_size == (int)sizeof(int)*CHAR_BIT)
+	run_progarray_int(progarray, map_hugeram());
+    else
+#endif
+#ifdef RUNARRAY_64
+    if (cell_size <= 0 && cell_length == 64)
+	run_progarray_64(progarray, map_hugeram());
+    else
+#endif
+#ifdef RUNARRAY_128
+    if (cell_size <= 0 && cell_length == 128)
+	run_progarray_128(progarray, map_hugeram());
+    else
+#endif
+	run_progarray(progarray, map_hugeram());
     finish_runclock(&run_time, &io_time);
+
+    if (ra_loops) {
+	size_t i;
+	for(i=0; loop_index && i<arraylen+2; i++)
+	    if (loop_index[i])
+		loop_counts[loop_index[i]] = ra_loops[i];
+	free(ra_loops);
+	free(loop_index);
+	ra_loops = 0;
+    }
+    free(ra_trace);
+    ra_trace = 0;
+    free(ra_wdloop);
+    ra_wdloop = 0;
     free(progarray);
 }
 
-#if defined(__GNUC__) && ((__GNUC__>4) || (__GNUC__==4 && __GNUC_MINOR__>=4))
-__attribute__((optimize(3),noinline,hot))
+/*
+ * The watchdog compares the tape bytes so the cells must wrap in their
+ * own type; with a mask the same state may not look the same.
+ */
+static void
+run_watchdog(int * progarray)
+{
+#ifdef RUNARRAY_8
+    if (cell_size == 8)
+	run_progarray_wd8(progarray, map_hugeram());
+    else
+#endif
+#ifdef RUNARRAY_16
+    if (cell_size == 16)
+	run_progarray_wd16(progarray, map_hugeram());
+    else
+#endif
+#ifdef RUNARRAY_INT
+    if (cell_size == (int)sizeof(int)*CHAR_BIT)
+	run_progarray_wdint(progarray, map_hugeram());
+    else
 #endif
+	run_progarray_wd(progarray, map_hugeram());
+}
 
+/* The counts are kept at the same speed as a normal run of the tape. */
 static void
-run_progarray(int * p, icell * m)
+run_loop_counters(int * progarray)
+{
+#ifdef RUNARRAY_8
+    if (cell_size == 8)
+	run_progarray_lc8(progarray, map_hugeram());
+    else
+#endif
+#ifdef RUNARRAY_16
+    if (cell_size == 16)
+	run_progarray_lc16(progarray, map_hugeram());
+    else
+#endif
+#ifdef RUNARRAY_INT
+    if (cell_size == (int)sizeof(int)*CHAR_BIT)
+	run_progarray_lcint(progarray, map_hugeram());
+    else
+#endif
+	run_progarray_lc(progarray, map_hugeram());
+}
+
+/*
+ * For libtritium; the program array is built once and can then be run by
+ * any number of threads at the same time, each with its own tape.
+ */
+int *
+runarray_program(void)
+{
+    size_t arraylen;
+#ifndef DYNAMIC_MASK
+    if (cell_size > 0 && cell_mask != MASK) return 0;
+#endif
+    if (cell_size <= 0) return 0;
+    return build_runarray(&arraylen, 0, 0);
+}
+
+/*
+ * The tape is the cells from tape for the length given, the run starts at
+ * cell start. The cell mask and the -E choice are the compile's, not the
+ * globals. Returns zero if the run stopped early.
+ */
+int
+runarray_run(int * progarray, void * tape, size_t cells, long start,
+	int mask, int eof, struct tritium_run * io)
 {
+    io->error = 0;
+    run_progarray_io(progarray, (icell*)tape + start, io, tape, cells,
+	    mask, eof);
+    return !io->error;
+}
+
+/*
+ * The -Orun trial run; it stops at the T_SUSP put in by try_opt_runner()
+ * or at an input once the -spec-input has been read and the tree is then
+ * rebuilt. If T_SUSP was at a loop that's never run it's moved past the
+ * loop and the run carries on from the next op; the new T_SUSP is further
+ * on so the array is the same up to there.
+ */
+int
+runarray_trial(void)
+{
+#ifndef DYNAMIC_MASK
+    return 0;
+#else
+    size_t arraylen;
+    int * progarray, * p;
+    struct bfi ** nodes, * n;
+    icell * tape;
+    long pos;
+    int type, offset;
+
+    if (cell_size <= 0) return 0;
+
+    p = progarray = build_runarray(&arraylen, 0, &nodes);
+    ra_trial.low = ra_trial.high = tape = map_hugeram();
+    ra_trial.m = tape;
+
+    for(;;) {
+	run_progarray_trial(p, ra_trial.m);
+	pos = ra_trial.p - progarray;
+	type = ra_trial.p[1];
+	n = nodes[pos];
+	free(progarray);
+	free(nodes);
+
+	if (ra_trial.low - tape < profile_min_cell)
+	    profile_min_cell = (int)(ra_trial.low - tape);
+	if (ra_trial.high - tape > profile_max_cell)
+	    profile_max_cell = (int)(ra_trial.high - tape);
+
+	/* The end of the array has no node */
+	if (type == T_STOP && n) {
+	    fprintf(stderr, "Error: Trial run optimise hit T_STOP.\n");
+	    exit(1);
+	}
+	offset = (int)(ra_trial.m - tape) - (n ? n->offset : 0);
+
+	if (type != T_SUSP) {
+	    opt_runner_stop(n, tape, offset);
+	    break;
+	}
+	if (!update_opt_runner(n->next, tape, offset))
+	    break;
+
+	progarray = build_runarray(&arraylen, 0, &nodes);
+	p = progarray + pos + 2;
+    }
+    return 1;
+#endif
+}
+
+static int
+eof_cell(int eof, int oldch)
+{
+    switch(eof)
+    {
+    case 2: return -1;
+    case 3: return 0;
+    case 4: return EOF;
+    default: return oldch;
+    }
+}
+
+/*
+ * The loop and time limits of a libtritium run, like the watchdog's; the
+ * interpreter counts down at each T_END and io_limit() is called when the
+ * count goes negative. The clock is only read every 2^20 back-edges.
+ */
+struct io_limit {
+    long count, chunk;
+    unsigned long long edges;
+    double start;
+};
+
+static void
+io_limit_next(struct io_limit * lim, const struct tritium_run * io)
+{
+    unsigned long long c = io->time_limit > 0 ? 1UL<<20 : LONG_MAX;
+    if (io->loop_limit && io->loop_limit - lim->edges < c)
+	c = io->loop_limit - lim->edges + 1;
+    lim->chunk = (long)c;
+    lim->count = lim->chunk - 1;
+}
+
+static void
+io_limit_start(struct io_limit * lim, const struct tritium_run * io)
+{
+    lim->edges = 0;
+    lim->start = io->time_limit > 0 ? wall_clock() : 0;
+    io_limit_next(lim, io);
+}
+
+static int
+io_limit(struct io_limit * lim, struct tritium_run * io)
+{
+    lim->edges += (unsigned long long)lim->chunk;
+    if ((io->loop_limit && lim->edges > io->loop_limit) ||
+	    (io->time_limit > 0 && wall_clock() - lim->start > io->time_limit)) {
+	io->error = TRITIUM_ELIMIT;
+	return 0;
+    }
+    io_limit_next(lim, io);
+    return 1;
+}
+
+/*
+ * The lockstep interpreter for libtritium; up to RUNARRAY_LANES copies of
+ * the program run together, one for each input. The tape is interleaved,
+ * cell i of lane l is at tape[i*RUNARRAY_LANES+l], so every op is a short
+ * loop over the lanes that the compiler can vectorise.
+ *
+ * The lanes share the program counter and the tape pointer. When they
+ * disagree at a loop, an if or a rail search the lanes that went the other
+ * way are parked with the op and pointer they're waiting at; they rejoin
+ * when the running lanes get to the same op with the same pointer. If the
+ * running lanes all stop the top parked group carries on. When fewer than
+ * RUNARRAY_LANES_MIN lanes are left running they are handed to eject()
+ * to finish on the normal interpreter, each is given the op to start at
+ * and its tape cell; a step of every lane costs more than that.
+ *
+ * The '#' dump is not done here.
+ */
+#define LANES	    RUNARRAY_LANES
+#define LANE_ALL    ((1U<<LANES)-1)
+
+struct lane_park {
+    int * p;
+    icell * m;
+    unsigned mask;
+};
+
+static int
+lane_getch(struct tritium_run * io, int eof, int oldch)
+{
+    if (io->input_pos < io->input_len)
+	return (unsigned char)io->input[io->input_pos++];
+    return eof_cell(eof, oldch);
+}
+
+static void
+lane_putch(struct tritium_run * io, int ch)
+{
+    if (io->output_len >= io->output_size && io->flush) {
+	io->flush(io);
+	if (io->error) return;
+    }
+    if (io->output_len < io->output_size)
+	io->output[io->output_len++] = (char)ch;
+    else
+	io->truncated = 1;
+}
+
+static struct lane_park *
+lane_park(struct lane_park * park, int * npark, int * maxpark,
+	int * p, icell * m, unsigned mask)
+{
+    if (*npark && park[*npark-1].p == p && park[*npark-1].m == m) {
+	park[*npark-1].mask |= mask;
+	return park;
+    }
+    if (*npark >= *maxpark) {
+	*maxpark = *maxpark ? *maxpark*2 : 16;
+	park = realloc(park, *maxpark * sizeof(*park));
+	if (!park) { perror("realloc"); exit(1); }
+    }
+    park[*npark].p = p;
+    park[*npark].m = m;
+    park[*npark].mask = mask;
+    ++*npark;
+    return park;
+}
+
+#if defined(__GNUC__) && ((__GNUC__>4) || (__GNUC__==4 && __GNUC_MINOR__>=4))
+__attribute__((optimize(3),noinline,hot))
+#endif
+void
+runarray_lanes(int * p, void * tape, size_t cells, long start,
+	int mask, int eof, int nlanes, struct tritium_run ** io,
+	void (*eject)(void * ctx, int lane, int * p, long cell), void * ctx)
+{
+    icell * const lo = tape;
+    icell * const m0 = lo + start*LANES;
+    icell * m = m0;
+    const size_t lim = cells*LANES;
+    struct lane_park * park = 0;
+    int npark = 0, maxpark = 0;
+    unsigned act, dead, z, on_act = 0;
+    icell on[LANES], t1[LANES], t2[LANES];
+    int l, v1, v2, v3;
 #ifdef DYNAMIC_MASK
-    const icell msk = (icell)cell_mask;
-#define M(x) ((x) &= msk)
+    const icell msk = (icell)mask;
+#define LM(x) ((x) &= msk)
+#else
+#define LM(x) M(x)
 #endif
+/*
+ * Set the cell of each running lane; if any lane needs protecting the old
+ * value is kept for it. The values from the op and other cells are copied
+ * to locals first so the compiler knows the loops don't overlap.
+ */
+#define LANES_SET(expr) do {						\
+	if ((act|dead) == LANE_ALL) {					\
+	    for(l=0; l<LANES; l++) m[l] = (icell)(expr);		\
+	} else {							\
+	    if (on_act != act)						\
+		for(on_act = act, l=0; l<LANES; l++)			\
+		    on[l] = (act>>l) & 1;				\
+	    for(l=0; l<LANES; l++)					\
+		m[l] = on[l] ? (icell)(expr) : m[l];			\
+	}								\
+    } while(0)
+#define LANES_GET(t, off) memcpy((t), m+(off)*LANES, sizeof(t))
+/* The I/O is only ever for the running lanes. */
+#define LANES_IO(stmt) do {						\
+	for(l=0; l<LANES; l++) if (act & (1U<<l)) { stmt; }		\
+    } while(0)
+/* A lane whose flush function set its error stops there. */
+#define LANES_PUT(ch) LANES_IO(lane_putch(io[l], (ch));			\
+	if (io[l]->error) { act &= ~(1U<<l); dead |= 1U<<l; })
+#define LANES_ZERO() do {						\
+	z = 0;								\
+	for(l=0; l<LANES; l++)						\
+	    if ((act & (1U<<l)) && LM(m[l]) == 0) z |= 1U<<l;		\
+    } while(0)
+/* The pointer has left the tape; the running lanes fail. */
+#define LANES_OFF(x)	((size_t)((x) - lo) >= lim)
+#define LANES_FAIL() do {						\
+	LANES_IO(io[l]->error = TRITIUM_ETAPE);				\
+	dead |= act;							\
+	act = 0;							\
+    } while(0)
+
+    if (nlanes > LANES) nlanes = LANES;
+    memset(on, 0, sizeof(on));
+    act = LANE_ALL >> (LANES-nlanes);
+    dead = LANE_ALL & ~act;
+
     for(;;) {
-	m += p[0];
+	while (npark && park[npark-1].p == p && park[npark-1].m == m)
+	    act |= park[--npark].mask;
+	if (act == 0) {
+	    if (npark == 0) break;
+	    npark--;
+	    p = park[npark].p;
+	    m = park[npark].m;
+	    act = park[npark].mask;
+	}
+	for(z=act, l=0; z && l<RUNARRAY_LANES_MIN; l++)
+	    z &= z-1;
+	if (l < RUNARRAY_LANES_MIN) {
+	    for(l=0; l<LANES; l++)
+		if (act & (1U<<l))
+		    eject(ctx, l, p, (long)(m-m0)/LANES);
+	    dead |= act;
+	    act = 0;
+	    continue;
+	}
+
+	m += p[0]*LANES;
 	switch(p[1])
 	{
-	case T_ADD: *m += p[2]; p += 3; break;
-	case T_SET: *m = p[2]; p += 3; break;
+	case T_ADD: v1 = p[2]; LANES_SET(m[l] + v1); p += 3; break;
+	case T_SET: v1 = p[2]; LANES_SET(v1); p += 3; break;
 
 	case T_END:
-	    if(M(*m) != 0) p += p[2];
+	    if (LANES_OFF(m)) { LANES_FAIL(); continue; }
+	    LANES_ZERO();
+	    if (z == 0)
+		p += p[2];
+	    else if (z != act) {
+		park = lane_park(park, &npark, &maxpark, p+3, m, z);
+		act &= ~z;
+		p += p[2];
+	    }
 	    p += 3;
 	    break;
 
 	case T_WHL:
-	    if(M(*m) == 0) p += p[2];
+	    if (LANES_OFF(m)) { LANES_FAIL(); continue; }
+	    LANES_ZERO();
+	    if (z == act)
+		p += p[2];
+	    else if (z) {
+		park = lane_park(park, &npark, &maxpark, p+p[2]+3, m, z);
+		act &= ~z;
+	    }
 	    p += 3;
 	    break;
 
@@ -251,75 +843,265 @@ run_progarray(int * p, icell * m)
 	    break;
 
 	case T_CALC:
-	    *m = p[2] + m[p[3]] * p[4] + m[p[5]] * p[6];
+	    LANES_GET(t1, p[3]);
+	    LANES_GET(t2, p[5]);
+	    v1 = p[2]; v2 = p[4]; v3 = p[6];
+	    LANES_SET(v1 + t1[l] * v2 + t2[l] * v3);
 	    p += 7;
 	    break;
 
 	case T_CALC2:
-	    *m = p[2] + m[p[3]] * p[4];
+	    LANES_GET(t1, p[3]);
+	    v1 = p[2]; v2 = p[4];
+	    LANES_SET(v1 + t1[l] * v2);
 	    p += 5;
 	    break;
 
 	case T_CALC3:
-	    *m += m[p[2]] * p[3];
+	    LANES_GET(t1, p[2]);
+	    v1 = p[3];
+	    LANES_SET(m[l] + t1[l] * v1);
 	    p += 4;
 	    break;
 
 	case T_CALC4:
-	    *m = m[p[2]];
+	    LANES_GET(t1, p[2]);
+	    LANES_SET(t1[l]);
 	    p += 3;
 	    break;
 
 	case T_CALC5:
-	    *m += m[p[2]];
-	    p += 3;
-	    break;
-
-	case T_ADDWZ:
-	    /* This is normally a running dec, it cleans up a rail */
-	    while(M(*m)) {
-		m[p[2]] += p[3];
-		m += p[4];
-	    }
-	    p += 5;
-	    break;
-
-	case T_ZFIND:
-	    /* Search along a rail til you find the end of it. */
-	    while(M(*m)) {
-		m += p[2];
-	    }
+	    LANES_GET(t1, p[2]);
+	    LANES_SET(m[l] + t1[l]);
 	    p += 3;
 	    break;
 
-	case T_MFIND:
-	    /* Search along a rail for a minus 1 */
-	    while(M(*m)) {
-		*m -= 1;
-		m += p[2];
-		*m += 1;
+	case T_ADDWZ: case T_ZFIND: case T_MFIND:
+	    /* Each lane searches on its own; lanes that stop somewhere
+	     * other than the first are parked where they stopped. */
+	    {
+		int k[LANES], j, first = -1, op = p[1];
+		for(l=0; l<LANES; l++) {
+		    if (!(act & (1U<<l))) continue;
+		    j = 0;
+		    if (op == T_ADDWZ)
+			while(LM(m[j*LANES+l])) {
+			    m[(j+p[2])*LANES+l] += p[3];
+			    j += p[4];
+			    if (LANES_OFF(m+j*LANES)) break;
+			}
+		    else if (op == T_ZFIND)
+			while(LM(m[j*LANES+l])) {
+			    j += p[2];
+			    if (LANES_OFF(m+j*LANES)) break;
+			}
+		    else
+			while(LM(m[j*LANES+l])) {
+			    m[j*LANES+l] -= 1;
+			    j += p[2];
+			    if (LANES_OFF(m+j*LANES)) break;
+			    m[j*LANES+l] += 1;
+			}
+		    if (LANES_OFF(m+j*LANES)) {
+			io[l]->error = TRITIUM_ETAPE;
+			act &= ~(1U<<l);
+			dead |= 1U<<l;
+			continue;
+		    }
+		    k[l] = j;
+		    if (first < 0) first = l;
+		}
+		p += (op == T_ADDWZ) ? 5 : 3;
+		if (first < 0) break;
+		for(l=0; l<LANES; l++) {
+		    int l2;
+		    if (!(act & (1U<<l)) || k[l] == k[first]) continue;
+		    for(z=0, l2=l; l2<LANES; l2++)
+			if ((act & (1U<<l2)) && k[l2] == k[l])
+			    z |= 1U<<l2;
+		    park = lane_park(park, &npark, &maxpark, p, m+k[l]*LANES, z);
+		    act &= ~z;
+		}
+		m += k[first]*LANES;
 	    }
-	    p += 3;
 	    break;
 
 	case T_INP:
-	    *m = getch(*m);
+	    LANES_IO(m[l] = lane_getch(io[l], eof, m[l]));
 	    p += 2;
 	    break;
 
 	case T_PRT:
-	    putch(*m);
+	    LANES_PUT(m[l]);
 	    p += 2;
 	    break;
 
 	case T_CHR:
-	    putch(p[2]);
+	    LANES_PUT(p[2]);
 	    p += 3;
 	    break;
 
+	case T_STR:
+	    {	int i;
+		for(i=0; i<p[2]; i++)
+		    LANES_PUT(((char*)(p+3))[i]);
+	    }
+	    p += 3 + ((size_t)p[2] + sizeof(int) - 1) / sizeof(int);
+	    break;
+
+	case T_DUMP:
+	    p += 4;
+	    break;
+
 	case T_STOP:
-	    goto break_break;
+	    dead |= act;
+	    act = 0;
+	    break;
 	}
     }
-break_break:;
+    free(park);
+#undef LM
+#undef LANES_SET
+#undef LANES_GET
+#undef LANES_IO
+#undef LANES_PUT
+#undef LANES_ZERO
+#undef LANES_OFF
+#undef LANES_FAIL
 }
+
+#define RA_FN run_progarray
+#define RA_CELL icell
+#ifndef DYNAMIC_MASK
+#define RA_M(x) M(x)
+#endif
+#include "bfi.runarray.def"
+
+/* For -floop-counters, works for any cell that fits in an int. */
+#define RA_FN run_progarray_lc
+#define RA_CELL icell
+#define RA_LOOPS ra_loops
+#ifndef DYNAMIC_MASK
+#define RA_M(x) M(x)
+#endif
+#include "bfi.runarray.def"
+
+/* For -trace-file; also counts the loops so both can be used. */
+#define RA_FN run_progarray_tr
+#define RA_CELL icell
+#define RA_LOOPS ra_loops
+#define RA_TRACE ra_trace
+#ifndef DYNAMIC_MASK
+#define RA_M(x) M(x)
+#endif
+#include "bfi.runarray.def"
+
+/* For libtritium, the I/O is to the caller's buffers. */
+#define RA_FN run_progarray_io
+#define RA_CELL icell
+#define RA_IO io
+#ifndef DYNAMIC_MASK
+#define RA_M(x) M(x)
+#endif
+#include "bfi.runarray.def"
+
+/* For -fwatchdog and the run limits. */
+#define RA_FN run_progarray_wd
+#define RA_CELL icell
+#define RA_WATCHDOG ra_wdloop
+#ifndef DYNAMIC_MASK
+#define RA_M(x) M(x)
+#endif
+#include "bfi.runarray.def"
+
+#ifdef DYNAMIC_MASK
+/* For -Orun, the cells are left as ints for update_opt_runner() */
+#define RA_FN run_progarray_trial
+#define RA_CELL icell
+#define RA_TRIAL ra_trial
+#include "bfi.runarray.def"
+#endif
+
+#ifdef RUNARRAY_8
+#define RA_FN run_progarray_8
+#define RA_CELL unsigned char
+#define RA_M(x) (x)
+#define RA_LEAN
+#include "bfi.runarray.def"
+
+#define RA_FN run_progarray_8m
+#define RA_CELL unsigned char
+#define RA_LEAN
+#include "bfi.runarray.def"
+
+#define RA_FN run_progarray_wd8
+#define RA_CELL unsigned char
+#define RA_M(x) (x)
+#define RA_WATCHDOG ra_wdloop
+#include "bfi.runarray.def"
+
+#define RA_FN run_progarray_lc8
+#define RA_CELL unsigned char
+#define RA_M(x) (x)
+#define RA_LOOPS ra_loops
+#include "bfi.runarray.def"
+#endif
+
+#ifdef RUNARRAY_16
+#define RA_FN run_progarray_16
+#define RA_CELL unsigned short
+#define RA_M(x) (x)
+#define RA_LEAN
+#include "bfi.runarray.def"
+
+#define RA_FN run_progarray_16m
+#define RA_CELL unsigned short
+#define RA_LEAN
+#include "bfi.runarray.def"
+
+#define RA_FN run_progarray_wd16
+#define RA_CELL unsigned short
+#define RA_M(x) (x)
+#define RA_WATCHDOG ra_wdloop
+#include "bfi.runarray.def"
+
+#define RA_FN run_progarray_lc16
+#define RA_CELL unsigned short
+#define RA_M(x) (x)
+#define RA_LOOPS ra_loops
+#include "bfi.runarray.def"
+#endif
+
+#ifdef RUNARRAY_INT
+#define RA_FN run_progarray_int
+#define RA_CELL unsigned int
+#define RA_M(x) (x)
+#define RA_LEAN
+#include "bfi.runarray.def"
+
+#define RA_FN run_progarray_wdint
+#define RA_CELL unsigned int
+#define RA_M(x) (x)
+#define RA_WATCHDOG ra_wdloop
+#include "bfi.runarray.def"
+
+#define RA_FN run_progarray_lcint
+#define RA_CELL unsigned int
+#define RA_M(x) (x)
+#define RA_LOOPS ra_loops
+#include "bfi.runarray.def"
+#endif
+
+#ifdef RUNARRAY_64
+#define RA_FN run_progarray_64
+#define RA_CELL uint64_t
+#define RA_M(x) (x)
+#include "bfi.runarray.def"
+#endif
+
+#ifdef RUNARRAY_128
+#define RA_FN run_progarray_128
+#define RA_CELL unsigned __int128
+#define RA_M(x) (x)
+#include "bfi.runarray.def"
+#endif
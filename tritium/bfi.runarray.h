@@ -1,2 +1,15 @@
 
 void convert_tree_to_runarray(void);
+int checkcell_runarray(void);
+int runarray_trial(void);
+
+struct tritium_run;
+int * runarray_program(void);
+int runarray_run(int * progarray, void * tape, size_t cells, long start,
+	int mask, int eof, struct tritium_run * io);
+
+#define RUNARRAY_LANES	16
+#define RUNARRAY_LANES_MIN 5	/* Fewer lanes are quicker one by one */
+void runarray_lanes(int * p, void * tape, size_t cells, long start,
+	int mask, int eof, int nlanes, struct tritium_run ** io,
+	void (*eject)(void * ctx, int lane, int * p, long cell), void * ctx);
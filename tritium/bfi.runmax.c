@@ -102,12 +102,19 @@ run_maxtree(void)
 		break;
 
 	    case T_CHR:
-		putch(n->count);
+		n = putstr_nodes(n);
 		break;
 	    case T_PRT:
-		putch(p[n->offset]);
+		if (iostyle == 3)
+		    PUTINT_CELL(C, p[n->offset] & mask,
+			    cell_length == (int)(sizeof(C))*CHAR_BIT);
+		else
+		    putch(p[n->offset]);
 		break;
 	    case T_INP:
+		if (iostyle == 3)
+		    GETINT_CELL(C, p[n->offset]);
+		else
 		{   /* Cell may be too large for an int */
 		    int ch = -256;
 		    ch = getch(ch);
@@ -192,7 +199,11 @@ run_supertree(void)
     struct bfi * n = bfprog;
     register BIGNUM_V * m = move_ptr(alloc_ptr(mem),0);
     BIGNUM_V t1, t2, t3;
+    int intio_nw = (cell_length+15)/16;
+    unsigned * intio_words = 0;
     BN_init(t1); BN_init(t2); BN_init(t3);
+    if (iostyle == 3)
+	intio_words = tcalloc(intio_nw, sizeof(unsigned));
 
     if (verbose)
 	fprintf(stderr, "Maxtree variant: using OpenSSL Bignums\n");
@@ -276,9 +287,18 @@ run_supertree(void)
 		break;
 
 	    case T_CHR:
-		putch(n->count);
+		n = putstr_nodes(n);
 		break;
 	    case T_PRT:
+		if (iostyle == 3) {
+		    char * s;
+		    BN_mask_bits(m[n->offset], cell_length);
+		    if ((s = BN_bn2dec(m[n->offset])) != 0) {
+			putstr(s, strlen(s));
+			putstr("\n", 1);
+			OPENSSL_free(s);
+		    }
+		} else
 		{
 		    int input_chr;
 		    BN_zero(t2);
@@ -288,6 +308,17 @@ run_supertree(void)
 		}
 		break;
 	    case T_INP:
+		if (iostyle == 3) {
+		    int i, neg;
+		    if (getint_words(&neg, intio_words, intio_nw)) {
+			BN_zero(m[n->offset]);
+			for(i=intio_nw-1; i>=0; i--) {
+			    BN_lshift(m[n->offset], m[n->offset], 16);
+			    BN_add_word(m[n->offset], intio_words[i]);
+			}
+			BN_set_negative(m[n->offset], neg);
+		    }
+		} else
 		{   /* Cell is too large for an int */
 		    int ch = -256;
 		    ch = getch(ch);
@@ -465,7 +496,7 @@ static inline void BI_neg(uint_cell * a)
     int cy = 1, i;
     for(i=0; i<ints_per_cell; i++) {
 	a[i] = cy + ~a[i];
-	cy = (a[i] == 0);
+	cy = (cy && a[i] == 0);
     }
 }
 
@@ -553,6 +584,37 @@ static inline int BI_is_zero(uint_cell * a)
     return b == 0;
 }
 
+/* -fintio using 16 bit words in 'w'; the cell is copied to 't' first */
+static void
+BI_putint(uint_cell * a, uint_cell * t, unsigned * w, int sgn)
+{
+    int i, j, nw = 0, neg = 0;
+    BI_copy(t, a);
+    if (sgn && (t[ints_per_cell-1] >> (sizeof(uint_cell)*CHAR_BIT-1))) {
+	neg = 1;
+	BI_neg(t);
+    }
+    for(i=0; i<ints_per_cell; i++)
+	for(j=0; j<(int)sizeof(uint_cell); j+=2) {
+	    w[nw++] = (unsigned)(t[i] & 0xFFFF);
+	    t[i] >>= 16;
+	}
+    putint_words(neg, w, nw);
+}
+
+static void
+BI_getint(uint_cell * a, unsigned * w)
+{
+    int i, j, neg, wpl = (int)sizeof(uint_cell)/2;
+    if (!getint_words(&neg, w, ints_per_cell*wpl)) return;
+    for(i=0; i<ints_per_cell; i++) {
+	a[i] = 0;
+	for(j=wpl-1; j>=0; j--)
+	    a[i] = (a[i] << 16) | w[i*wpl+j];
+    }
+    if (neg) BI_neg(a);
+}
+
 static void
 run_supertree(void)
 {
@@ -561,6 +623,7 @@ run_supertree(void)
     uint_cell *t1, *t2, *t3;
     uint_cell mask_value = -1;
     int mask_offset = 0;
+    unsigned * intio_words = 0;
 
     ints_per_cell = sizeof(uint_cell)*CHAR_BIT -1;
     ints_per_cell += cell_length;
@@ -589,6 +652,8 @@ run_supertree(void)
     t1 = tcalloc(sizeof(uint_cell), ints_per_cell);
     t2 = tcalloc(sizeof(uint_cell), ints_per_cell);
     t3 = tcalloc(sizeof(uint_cell), ints_per_cell);
+    if (iostyle == 3)
+	intio_words = tcalloc(byte_per_cell/2, sizeof(unsigned));
 
     m = move_ptr(alloc_ptr(mem),0);
 
@@ -663,12 +728,20 @@ run_supertree(void)
 		break;
 
 	    case T_CHR:
-		putch(n->count);
+		n = putstr_nodes(n);
 		break;
 	    case T_PRT:
-		putch(m[n->offset*ints_per_cell]);
+		if (iostyle == 3) {
+		    m[n->offset*ints_per_cell+mask_offset] &= mask_value;
+		    BI_putint(m + n->offset*ints_per_cell, t1, intio_words,
+			byte_per_cell*CHAR_BIT == cell_length);
+		} else
+		    putch(m[n->offset*ints_per_cell]);
 		break;
 	    case T_INP:
+		if (iostyle == 3)
+		    BI_getint(m + n->offset*ints_per_cell, intio_words);
+		else
 		{   /* Cell is too large for an int */
 		    int ch = -256;
 		    ch = getch(ch);
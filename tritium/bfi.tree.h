@@ -25,6 +25,7 @@
 extern const char * bfname;
 extern int noheader, enable_trace, hard_left_limit, memsize, most_neg_maad_loop;
 extern int min_pointer, max_pointer;
+extern int profile_min_cell, profile_max_cell;
 extern int opt_level;
 extern int iostyle, eofcell;
 extern char * input_string;
@@ -41,6 +42,10 @@ extern int cell_type_iso;
 #define UM(vx) ((vx) & cell_mask)
 #define SM(vx) ((UM(vx) ^ cell_smask) - cell_smask)
 
+/* A T_CHR that can be part of a string written by putstr() */
+#define PUTSTR_CHAR(c) ((c) > 0 && (c) < (iostyle == 1 ? 128 : 256) && \
+			iostyle != 3 && UM(c) == (c))
+
 #define TOKEN_LIST(Mac) \
     Mac(MOV) Mac(ADD) Mac(PRT) Mac(INP) Mac(WHL) Mac(END) \
     Mac(SET) Mac(CALC) Mac(CHR) \
@@ -48,7 +53,7 @@ extern int cell_type_iso;
     Mac(ZFIND) Mac(MFIND) Mac(ADDWZ) \
     Mac(CALC2) Mac(CALC3) Mac(CALC4) Mac(CALC5) \
     Mac(STOP) Mac(SUSP) Mac(DUMP) \
-    Mac(NOP) Mac(DEAD) Mac(ERR) Mac(CALL)
+    Mac(NOP) Mac(DEAD) Mac(ERR) Mac(CALL) Mac(STR)
 
 #define GEN_TOK_ENUM(NAME) T_ ## NAME,
 enum token { TOKEN_LIST(GEN_TOK_ENUM) TCOUNT};
@@ -70,6 +75,7 @@ struct bfi
     int line, col;
     int inum;
     int ipos;
+    int loopid;
 
     int orgtype;
     struct bfi *prev;
@@ -88,8 +94,14 @@ extern int max_indent;
 
 void print_banner(FILE * fd, char const * program);
 void calculate_stats(void);
+int pointer_limit(int limit);
 void printtreecell(FILE * efd, int indent, struct bfi * n);
 void delete_tree(void);
+struct bfi * putstr_nodes(struct bfi * n);
+
+/* -floop-counters; entries to, and iterations of, loop n->loopid are
+ * loop_counts[loopid*2] and loop_counts[loopid*2+1]. */
+extern unsigned long long * loop_counts;
 
 void
 find_known_value(struct bfi * n, int v_offset, struct bfi ** n_found,
@@ -0,0 +1,176 @@
+#!/bin/sh
+# Check the bfi options that the plain test programs don't use. Every
+# program in ../testing that has a .opt file is run once for each line of
+# the .opt file with those options, using the .in file as input. The
+# output must match the .out file and the messages the .err file, if
+# there is one.
+#
+# A line that can't run an empty program is for an engine that this bfi
+# doesn't have, it's skipped. Some programs need more than one run; the
+# function for them leaves what is compared in the same files. The exit
+# status is zero if nothing failed.
+#
+# Usage: check.sh [-t timeout] [programs]
+
+BFI=${BFI:-./bfi}
+TESTDIR=${TESTDIR:-../testing}
+TIMEOUT=60
+
+while [ $# -gt 0 ]
+do
+    case "$1" in
+    -t) TIMEOUT="$2"; shift 2;;
+    -*) echo >&2 "Usage: $0 [-t timeout] [programs]"
+	exit 1;;
+    *) break;;
+    esac
+done
+
+PROGS="$*"
+[ "$PROGS" = "" ] && {
+    for f in "$TESTDIR"/*.opt
+    do [ -f "${f%.opt}.b" ] && PROGS="$PROGS `basename "${f%.opt}"`"
+    done
+}
+
+TMP="${TMPDIR:-/tmp}/check.$$"
+mkdir "$TMP" || exit 1
+trap 'rm -rf "$TMP"' 0
+trap 'exit 1' 1 2 15
+
+TO=
+[ "`which timeout 2>/dev/null`" != "" ] && TO="timeout $TIMEOUT"
+
+FAILED=0
+
+result() {
+    printf >&2 "%-12s %-32s %s\n" "$1" "$2" "$3"
+    [ "$3" = ok -o "$3" = skipped ] || FAILED=1
+}
+
+# Run the program with the options, the output is left in $TMP/out and
+# the messages in $TMP/err.
+run() {
+    B="$TESTDIR/$1.b"
+    IN=/dev/null; [ -f "$TESTDIR/$1.in" ] && IN="$TESTDIR/$1.in"
+    shift
+    $TO $BFI "$@" "$B" < "$IN" > "$TMP/out" 2> "$TMP/err"
+}
+
+# The --trace-file is decoded after the program's output.
+trace() {
+    run "$@" --trace-file="$TMP/trace" &&
+    $TO $BFI --trace-decode="$TMP/trace" >> "$TMP/out" 2>> "$TMP/err"
+}
+
+# The options are for a --serve server; four clients send the program at
+# once and must all get the same output, which is left in $TMP/out. A run
+# that leaves the tape and one that hits the loop limit must get an ERR.
+serve() {
+    B="$TESTDIR/$1.b"
+    IN=/dev/null; [ -f "$TESTDIR/$1.in" ] && IN="$TESTDIR/$1.in"
+    S="$TMP/sock"
+    shift
+    rm -f "$S"
+    $TO $BFI "$@" --serve="$S" < /dev/null > /dev/null 2> "$TMP/err" &
+    SERVER=$!
+    n=0
+    while [ ! -S "$S" -a $n -lt 50 ]
+    do sleep 0.1 2>/dev/null || sleep 1; n=`expr $n + 1`
+    done
+
+    OK=true
+    PIDS=
+    for c in 1 2 3 4
+    do
+	$TO $BFI --serve-client="$S" "$B" < "$IN" > "$TMP/out$c" 2>> "$TMP/err" &
+	PIDS="$PIDS $!"
+    done
+    for c in $PIDS
+    do wait $c || OK=false
+    done
+    mv "$TMP/out1" "$TMP/out"
+    for c in 2 3 4
+    do cmp -s "$TMP/out" "$TMP/out$c" || cat "$TMP/out$c" >> "$TMP/out"
+    done
+
+    $TO $BFI --serve-client="$S" -P '+[<+]' < /dev/null 2>&1 |
+	grep -q "ERR tape pointer moved outside the tape" || OK=false
+    echo x | $TO $BFI --serve-client="$S" -P ',[>+<]' 2>&1 |
+	grep -q "ERR loop or time limit reached" || OK=false
+
+    kill $SERVER
+    wait $SERVER 2>/dev/null
+    $OK
+}
+
+# A --batch list of four copies of the input and a file that's missing;
+# only the missing one may fail. The first output is left in $TMP/out and
+# any that differ from it are added on.
+batch() {
+    B="$TESTDIR/$1.b"
+    IN=/dev/null; [ -f "$TESTDIR/$1.in" ] && IN="$TESTDIR/$1.in"
+    shift
+    : > "$TMP/list"
+    for c in 1 2 3 4
+    do cp "$IN" "$TMP/in$c"; rm -f "$TMP/in$c.out"
+	echo "$TMP/in$c" >> "$TMP/list"
+    done
+    echo "$TMP/missing" >> "$TMP/list"
+    $TO $BFI "$@" --batch="$TMP/list" "$B" < /dev/null > /dev/null 2> "$TMP/err"
+    [ $? -eq 1 ] || return 1
+    mv "$TMP/in1.out" "$TMP/out" || return 1
+    for c in 2 3 4
+    do cmp -s "$TMP/out" "$TMP/in$c.out" || cat "$TMP/in$c.out" >> "$TMP/out"
+    done
+}
+
+# Two runs with one --auto-history file; both must give the output and
+# add a line for the same program to the history.
+autoengine() {
+    rm -f "$TMP/history"
+    run "$@" --auto-history="$TMP/history" &&
+    mv "$TMP/out" "$TMP/out1" &&
+    run "$@" --auto-history="$TMP/history" || return 1
+    cmp -s "$TMP/out" "$TMP/out1" || cat "$TMP/out1" >> "$TMP/out"
+    [ "`cut -d' ' -f1 "$TMP/history" | uniq | wc -l`" -eq 1 ] &&
+    [ "`wc -l < "$TMP/history"`" -eq 2 ]
+}
+
+# The program must be stopped with an error; only the place of the loop
+# in the message is compared.
+hang() {
+    run "$@"
+    [ $? -eq 1 ] || return 1
+    sed -n 's/.* in the loop at /in the loop at /p' "$TMP/err" > "$TMP/where"
+    mv "$TMP/where" "$TMP/err"
+}
+
+for p in $PROGS
+do
+    case $p in
+    Hang) RUN=hang;;
+    Auto) RUN=autoengine;;
+    Trace) RUN=trace;;
+    Serve) RUN=serve;;
+    Batch) RUN=batch;;
+    *) RUN=run;;
+    esac
+    while read OPTS
+    do
+	if ! $TO $BFI $OPTS -P '' < /dev/null > /dev/null 2>&1
+	then result $p "$OPTS" skipped; continue
+	fi
+	STATUS=ok
+	if ! $RUN $p $OPTS
+	then STATUS=failed
+	elif ! cmp -s "$TMP/out" "$TESTDIR/$p.out"
+	then STATUS=wrong
+	elif [ -f "$TESTDIR/$p.err" ] && ! cmp -s "$TMP/err" "$TESTDIR/$p.err"
+	then STATUS=wrong
+	fi
+	result $p "$OPTS" $STATUS
+    done < "$TESTDIR/$p.opt"
+done
+
+exit $FAILED
@@ -16,26 +16,93 @@
 # endif
 #endif
 
+#if defined(USE_POSIX_TIMERS) && !defined(DISABLE_TSC) && defined(__GNUC__)
+#if defined(__x86_64__) || defined(__i386__)
+#define USE_TSC
+#include <cpuid.h>
+#endif
+#endif
+
 #include "clock.h"
+#include "perfcnt.h"
+
+/*
+ * Called once by the next start_runclock(), ie: when the program has been
+ * compiled and is just about to run.
+ */
+void (*runclock_hook)(void) = 0;
+
+#define RUN_HOOK() do{ \
+	    void (*h)(void) = runclock_hook;	\
+	    if (h) { runclock_hook = 0; h(); }	\
+	} while(0)
 
 #if defined(USE_POSIX_TIMERS)
 
 static struct timespec run_start, paused, run_pause;
 
+#ifdef USE_TSC
+/*
+ * With an invariant TSC the pause and unpause around each I/O call are a
+ * pair of rdtsc instructions rather than two clock_gettime() calls. The
+ * start and finish still read the monotonic clock; the TSC rate comes
+ * from comparing the two over the run.
+ */
+static int use_tsc = -1;
+static unsigned long long tsc_start, tsc_pause, tsc_paused;
+
+static inline unsigned long long
+rdtsc(void)
+{
+    unsigned lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+static int
+tsc_invariant(void)
+{
+    unsigned a, b, c, d;
+    if (!__get_cpuid(0x80000007, &a, &b, &c, &d)) return 0;
+    return (d & (1U<<8)) != 0;
+}
+#endif
+
 void
 start_runclock(void)
 {
-    clock_gettime(CLOCK_MONOTONIC, &run_start);
+    RUN_HOOK();
     paused.tv_sec = 0;
     paused.tv_nsec = 0;
+#ifdef USE_TSC
+    if (use_tsc < 0) use_tsc = tsc_invariant();
+    tsc_paused = 0;
+    if (use_tsc) tsc_start = rdtsc();
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &run_start);
+    if (perfcnt_active) perfcnt_enable();
 }
 
 void
 finish_runclock(double * prun_time, double *pwait_time)
 {
     struct timespec run_end;
+    if (perfcnt_active) perfcnt_disable();
     clock_gettime(CLOCK_MONOTONIC, &run_end);
 
+#ifdef USE_TSC
+    if (use_tsc) {
+	unsigned long long ticks = rdtsc() - tsc_start;
+	double ns = (run_end.tv_sec - run_start.tv_sec) * 1e9
+		  + (run_end.tv_nsec - run_start.tv_nsec);
+	if (ticks > 0 && tsc_paused > 0) {
+	    double p = ns * ((double)tsc_paused / (double)ticks);
+	    paused.tv_sec = (time_t)(p / 1e9);
+	    paused.tv_nsec = (long)(p - paused.tv_sec * 1e9);
+	}
+    }
+#endif
+
     run_end.tv_sec -= run_start.tv_sec;
     run_end.tv_nsec -= run_start.tv_nsec;
     if (run_end.tv_nsec < 0)
@@ -55,6 +122,9 @@ finish_runclock(double * prun_time, double *pwait_time)
 void
 pause_runclock(void)
 {
+#ifdef USE_TSC
+    if (use_tsc > 0) { tsc_pause = rdtsc(); return; }
+#endif
     clock_gettime(CLOCK_MONOTONIC, &run_pause);
 }
 
@@ -63,6 +133,9 @@ unpause_runclock(void)
 {
     struct timespec run_end;
 
+#ifdef USE_TSC
+    if (use_tsc > 0) { tsc_paused += rdtsc() - tsc_pause; return; }
+#endif
     clock_gettime(CLOCK_MONOTONIC, &run_end);
     paused.tv_sec += run_end.tv_sec - run_pause.tv_sec;
     paused.tv_nsec += run_end.tv_nsec - run_pause.tv_nsec;
@@ -73,6 +146,14 @@ unpause_runclock(void)
         { paused.tv_nsec -= 1000000000; paused.tv_sec += 1; }
 }
 
+double
+wall_clock(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
 #elif defined(_WIN32)
 #include <windows.h>
 
@@ -92,17 +173,20 @@ static int failed = 0;
 void
 start_runclock(void)
 {
+    RUN_HOOK();
     Paused.QuadPart = 0;
     failed = !QueryPerformanceFrequency(&Frequency);
     if (Frequency.QuadPart == 0) failed = 1;
     if (!failed)
 	QueryPerformanceCounter(&Run_Start);
+    if (perfcnt_active) perfcnt_enable();
 }
 
 void
 finish_runclock(double * prun_time, double *pwait_time)
 {
     LARGE_INTEGER EndingTime;
+    if (perfcnt_active) perfcnt_disable();
     if(failed) return;
 
     QueryPerformanceCounter(&EndingTime);
@@ -132,6 +216,15 @@ unpause_runclock(void)
     Paused.QuadPart += EndingTime.QuadPart - Run_Pause.QuadPart;
 }
 
+double
+wall_clock(void)
+{
+    LARGE_INTEGER now, freq;
+    if (!QueryPerformanceFrequency(&freq) || freq.QuadPart == 0) return 0;
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart / freq.QuadPart;
+}
+
 #else
 #include <sys/time.h>
 
@@ -140,15 +233,18 @@ static struct timeval run_start, paused, run_pause;
 void
 start_runclock(void)
 {
+    RUN_HOOK();
     gettimeofday(&run_start, 0);
     paused.tv_sec = 0;
     paused.tv_usec = 0;
+    if (perfcnt_active) perfcnt_enable();
 }
 
 void
 finish_runclock(double * prun_time, double *pwait_time)
 {
     struct timeval run_end;
+    if (perfcnt_active) perfcnt_disable();
     gettimeofday(&run_end, 0);
 
     run_end.tv_sec -= run_start.tv_sec;
@@ -187,4 +283,12 @@ unpause_runclock(void)
     if (paused.tv_usec >= 1000000)
         { paused.tv_usec -= 1000000; paused.tv_sec += 1; }
 }
+
+double
+wall_clock(void)
+{
+    struct timeval now;
+    gettimeofday(&now, 0);
+    return now.tv_sec + now.tv_usec / 1e6;
+}
 #endif
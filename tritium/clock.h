@@ -3,3 +3,6 @@ void start_runclock(void);
 void finish_runclock(double * prun_time, double *pwait_time);
 void pause_runclock(void);
 void unpause_runclock(void);
+double wall_clock(void);
+
+extern void (*runclock_hook)(void);
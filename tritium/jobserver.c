@@ -0,0 +1,512 @@
+/*
+ * The --serve job server and its --serve-client.
+ *
+ * The server listens on a Unix domain socket. A request is a line
+ * "BF <program length> <input length>" then the program and the input.
+ * Each different program is compiled by libtritium the first time it's
+ * seen and kept, so later requests only pay for the run. The options are
+ * the ones the server was started with, so the program text is the key.
+ *
+ * The reply is "OK" or "ERR <why>" on a line. After an OK the output is
+ * sent as the program writes it in blocks, each a line with its length
+ * then the bytes. The run ends with a "0" line, or "ERR <why>" if it
+ * failed, and the server closes the connection.
+ *
+ * Every run has the -loop-limit and -time-limit the server was started
+ * with, or JOB_TIME_LIMIT if there are neither, and it's stopped as soon
+ * as the client goes away.
+ *
+ * Every connection gets its own thread and a tape from a pool; after a run
+ * only the touched pages of the tape are cleared before it's reused.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#if defined(AF_UNIX) && !defined(DISABLE_JOBSERVER)
+#include <sys/un.h>
+#define USE_JOBSERVER
+#endif
+
+/* DO_PTHREAD= in the makefile sets DISABLE_PTHREAD */
+#if !defined(DISABLE_PTHREAD) && defined(_POSIX_THREADS)
+#if _POSIX_THREADS > 0
+#define USE_THREADS
+#include <pthread.h>
+#endif
+#endif
+
+#include "libtritium.h"
+#include "jobserver.h"
+#include "watchdog.h"
+
+#ifdef USE_JOBSERVER
+
+/* Requests bigger than this are refused before anything is allocated. */
+#define MAX_PROGRAM	(16UL<<20)
+#define MAX_INPUT	(256UL<<20)
+/* Seconds a run may take if the server has no loop or time limit. */
+#define JOB_TIME_LIMIT	60.0
+
+#ifdef USE_THREADS
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK()	    pthread_mutex_lock(&cache_lock)
+#define UNLOCK()    pthread_mutex_unlock(&cache_lock)
+#else
+#define LOCK()
+#define UNLOCK()
+#endif
+
+/* The server's options, made from the command line's. */
+static struct tritium * jobs = 0;
+
+static struct job_prog {
+    struct job_prog * next;
+    unsigned long long hash;
+    size_t len;
+    char * source;
+    struct tritium_prog * prog;
+} * programs = 0;
+
+static struct job_tape {
+    struct job_tape * next;
+    struct tritium_tape * tape;
+} * free_tapes = 0;
+
+struct job_out {
+    int fd;
+    int failed;
+    char buf[4096];
+};
+
+static unsigned long long
+fnv1a(const char * s, size_t len)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    while(len-- > 0) {
+	h ^= (unsigned char)*s++;
+	h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int
+write_all(int fd, const char * s, size_t len)
+{
+    ssize_t rv;
+    while(len > 0) {
+	rv = write(fd, s, len);
+	if (rv < 0 && errno == EINTR) continue;
+	if (rv <= 0) return 0;
+	s += rv;
+	len -= (size_t)rv;
+    }
+    return 1;
+}
+
+static int
+read_all(int fd, char * s, size_t len)
+{
+    ssize_t rv;
+    while(len > 0) {
+	rv = read(fd, s, len);
+	if (rv < 0 && errno == EINTR) continue;
+	if (rv <= 0) return 0;
+	s += rv;
+	len -= (size_t)rv;
+    }
+    return 1;
+}
+
+/* The cache lock must be held. */
+static struct job_prog *
+cached_program(unsigned long long h, const char * source, size_t len)
+{
+    struct job_prog * p;
+    for(p=programs; p; p=p->next)
+	if (p->hash == h && p->len == len && !memcmp(p->source, source, len))
+	    break;
+    return p;
+}
+
+/*
+ * Find the compiled program, compiling it the first time. The compile is
+ * done without the cache lock so the other clients carry on; if another
+ * thread compiled the same program meanwhile its copy is used.
+ */
+static struct tritium_prog *
+find_program(const char * source, size_t len)
+{
+    unsigned long long h = fnv1a(source, len);
+    struct job_prog * p, * np;
+
+    LOCK();
+    p = cached_program(h, source, len);
+    UNLOCK();
+    if (p) return p->prog;
+
+    if ((np = calloc(1, sizeof(*np))) == 0) return 0;
+    np->hash = h;
+    np->len = len;
+    if ((np->source = malloc(len+1)) != 0) {
+	memcpy(np->source, source, len+1);
+	np->prog = tritium_compile(jobs, source);
+    }
+    if (!np->prog) {
+	free(np->source);
+	free(np);
+	return 0;
+    }
+
+    LOCK();
+    if ((p = cached_program(h, source, len)) == 0) {
+	np->next = programs;
+	programs = p = np;
+	np = 0;
+    }
+    UNLOCK();
+    if (np) {
+	tritium_free(np->prog);
+	free(np->source);
+	free(np);
+    }
+    return p->prog;
+}
+
+static struct job_tape *
+get_tape(void)
+{
+    struct job_tape * t;
+
+    LOCK();
+    if ((t = free_tapes) != 0)
+	free_tapes = t->next;
+    UNLOCK();
+    if (t) return t;
+
+    if ((t = calloc(1, sizeof(*t))) == 0) return 0;
+    if ((t->tape = tritium_tape_new(jobs)) == 0) {
+	free(t);
+	return 0;
+    }
+    return t;
+}
+
+static void
+put_tape(struct job_tape * t)
+{
+    LOCK();
+    t->next = free_tapes;
+    free_tapes = t;
+    UNLOCK();
+}
+
+/* If the client has gone the run is stopped. */
+static void
+send_output(struct tritium_run * run)
+{
+    struct job_out * out = run->user;
+    char line[32];
+
+    if (!out->failed) {
+	sprintf(line, "%lu\n", (unsigned long)run->output_len);
+	if (!write_all(out->fd, line, strlen(line)) ||
+		!write_all(out->fd, run->output, run->output_len))
+	    out->failed = 1;
+    }
+    if (out->failed)
+	run->error = TRITIUM_ESTOP;
+    run->output_len = 0;
+}
+
+/* A line without its newline; an empty line if the connection closed. */
+static int
+read_line(int fd, char * line, size_t size)
+{
+    size_t i;
+    for(i=0; i<size-1; i++)
+	if (!read_all(fd, line+i, 1) || line[i] == '\n') break;
+    line[i] = 0;
+    return i > 0;
+}
+
+static void
+reply(int fd, const char * msg)
+{
+    write_all(fd, msg, strlen(msg));
+}
+
+static void
+run_job(int fd)
+{
+    char line[64], * source = 0, * input = 0;
+    unsigned long plen, ilen;
+    struct tritium_prog * prog;
+    struct job_tape * t;
+    struct tritium_run run;
+    struct job_out * out = 0;
+
+    read_line(fd, line, sizeof(line));
+    if (sscanf(line, "BF %lu %lu", &plen, &ilen) != 2) {
+	reply(fd, "ERR bad request\n");
+	return;
+    }
+    if (plen > MAX_PROGRAM || ilen > MAX_INPUT) {
+	reply(fd, "ERR request too large\n");
+	return;
+    }
+
+    source = malloc(plen+1);
+    input = malloc(ilen+1);
+    if (!source || !input) {
+	reply(fd, "ERR out of memory\n");
+	goto done;
+    }
+    if (!read_all(fd, source, plen) || !read_all(fd, input, ilen))
+	goto done;
+    source[plen] = 0;
+
+    if ((prog = find_program(source, plen)) == 0) {
+	reply(fd, "ERR cannot compile program\n");
+	goto done;
+    }
+    if ((t = get_tape()) == 0 || (out = malloc(sizeof(*out))) == 0) {
+	if (t) put_tape(t);
+	reply(fd, "ERR out of memory\n");
+	goto done;
+    }
+    reply(fd, "OK\n");
+
+    memset(&run, 0, sizeof(run));
+    out->fd = fd;
+    out->failed = 0;
+    run.input = input;
+    run.input_len = ilen;
+    run.output = out->buf;
+    run.output_size = sizeof(out->buf);
+    run.flush = send_output;
+    run.user = out;
+    run.loop_limit = loop_limit;
+    run.time_limit = time_limit;
+    if (!loop_limit && time_limit <= 0)
+	run.time_limit = JOB_TIME_LIMIT;
+    /* A pooled tape may be too small for a program compiled after it. */
+    if (!tritium_run_tape(prog, t->tape, &run)) {
+	tritium_tape_free(t->tape);
+	if ((t->tape = tritium_tape_new(jobs)) == 0) {
+	    free(t);
+	    reply(fd, "ERR out of memory\n");
+	    goto done;
+	}
+	tritium_run_tape(prog, t->tape, &run);
+    }
+    put_tape(t);
+    /* There's nobody to tell about a TRITIUM_ESTOP. */
+    switch(run.error) {
+    case 0:
+	reply(fd, "0\n");
+	break;
+    case TRITIUM_ETAPE:
+	reply(fd, "ERR tape pointer moved outside the tape\n");
+	break;
+    case TRITIUM_ELIMIT:
+	reply(fd, "ERR loop or time limit reached\n");
+	break;
+    }
+
+done:
+    free(out);
+    free(source);
+    free(input);
+}
+
+#ifdef USE_THREADS
+static void *
+job_thread(void * arg)
+{
+    int fd = (int)(size_t)arg;
+    run_job(fd);
+    close(fd);
+    return 0;
+}
+#endif
+
+int
+jobserver(const char * path)
+{
+    struct sockaddr_un addr;
+    int sfd, fd;
+
+    if ((jobs = tritium_new(0, 0)) == 0)
+	return 1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+	fprintf(stderr, "%s: socket path is too long\n", path);
+	return 1;
+    }
+    strcpy(addr.sun_path, path);
+
+    if ((sfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+	perror("socket");
+	return 1;
+    }
+    unlink(path);
+    if (bind(sfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(sfd, 64) < 0) {
+	perror(path);
+	close(sfd);
+	return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    for(;;) {
+	if ((fd = accept(sfd, 0, 0)) < 0) {
+	    if (errno == EINTR || errno == ECONNABORTED) continue;
+	    perror("accept");
+	    break;
+	}
+#ifdef USE_THREADS
+	{
+	    pthread_t th;
+	    pthread_attr_t attr;
+	    pthread_attr_init(&attr);
+	    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	    if (pthread_create(&th, &attr, job_thread, (void*)(size_t)fd) == 0) {
+		pthread_attr_destroy(&attr);
+		continue;
+	    }
+	    pthread_attr_destroy(&attr);
+	}
+#endif
+	run_job(fd);
+	close(fd);
+    }
+    close(sfd);
+    return 1;
+}
+
+/* Read all of a file into memory, the length is returned in *lenp. */
+static char *
+slurp(FILE * ifd, size_t * lenp)
+{
+    size_t len = 0, size = 4096;
+    char * s = malloc(size), * ns;
+    size_t got;
+
+    while(s && (got = fread(s+len, 1, size-len, ifd)) > 0) {
+	len += got;
+	if (len == size) {
+	    if ((ns = realloc(s, size*2)) == 0) { free(s); return 0; }
+	    s = ns;
+	    size *= 2;
+	}
+    }
+    *lenp = len;
+    return s;
+}
+
+/*
+ * Send the program and the whole of stdin to the server and copy the
+ * program's output to stdout.
+ */
+int
+jobclient(const char * path, const char * fname, const char * source)
+{
+    struct sockaddr_un addr;
+    char line[64], buf[4096], * prog = 0, * input;
+    size_t plen, ilen;
+    unsigned long len;
+    size_t got;
+    int fd;
+    FILE * ifd;
+
+    if (source) {
+	plen = strlen(source);
+	prog = malloc(plen+1);
+	if (prog) memcpy(prog, source, plen+1);
+    } else {
+	if (!fname || strcmp(fname, "-") == 0) {
+	    fprintf(stderr, "The program must be a file or -P, stdin is "
+			    "the input for the job\n");
+	    return 1;
+	}
+	if ((ifd = fopen(fname, "r")) == 0) {
+	    perror(fname);
+	    return 1;
+	}
+	prog = slurp(ifd, &plen);
+	fclose(ifd);
+    }
+    if (!prog || (input = slurp(stdin, &ilen)) == 0) {
+	perror("read");
+	return 1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path)-1);
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+	    connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+	perror(path);
+	return 1;
+    }
+
+    sprintf(line, "BF %lu %lu\n", (unsigned long)plen, (unsigned long)ilen);
+    if (!write_all(fd, line, strlen(line)) || !write_all(fd, prog, plen) ||
+	    !write_all(fd, input, ilen)) {
+	perror(path);
+	return 1;
+    }
+    free(prog);
+    free(input);
+
+    fflush(stdout);
+    if (!read_line(fd, line, sizeof(line)) || strcmp(line, "OK") != 0) {
+	fprintf(stderr, "%s: %s\n", path, *line ? line : "no reply");
+	return 1;
+    }
+
+    /* Blocks of output until a zero length one or an error. */
+    for(;;) {
+	if (!read_line(fd, line, sizeof(line)) ||
+		line[0] < '0' || line[0] > '9') {
+	    fprintf(stderr, "%s: %s\n", path, *line ? line : "no reply");
+	    return 1;
+	}
+	if ((len = strtoul(line, 0, 10)) == 0) break;
+	while(len > 0) {
+	    got = len < sizeof(buf) ? len : sizeof(buf);
+	    if (!read_all(fd, buf, got)) {
+		fprintf(stderr, "%s: connection lost\n", path);
+		return 1;
+	    }
+	    if (!write_all(1, buf, got)) {
+		perror("write");
+		return 1;
+	    }
+	    len -= got;
+	}
+    }
+    close(fd);
+    return 0;
+}
+
+#else
+int jobserver(const char * path)
+{
+    fprintf(stderr, "%s: the job server is not available\n", path);
+    return 1;
+}
+int jobclient(const char * path, const char * fname, const char * source)
+{
+    (void)fname; (void)source;
+    return jobserver(path);
+}
+#endif
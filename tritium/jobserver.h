@@ -0,0 +1,3 @@
+
+int jobserver(const char * path);
+int jobclient(const char * path, const char * fname, const char * source);
@@ -0,0 +1,399 @@
+/*
+ * Checks for libtritium, run by "make check".
+ *
+ * Each check prints a line like check.sh does; the exit status is zero if
+ * they all passed. The runs use the library's own buffers and no files.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* DO_PTHREAD= in the makefile sets DISABLE_PTHREAD */
+#if !defined(DISABLE_PTHREAD) && defined(_POSIX_THREADS)
+#if _POSIX_THREADS > 0
+#define USE_THREADS
+#include <pthread.h>
+#endif
+#endif
+
+#include "libtritium.h"
+
+#define THREADS	8
+#define RUNS	200
+#define LANES	40
+
+/* Writes the input backwards */
+static const char reverse[] = ">,[>,]<[.<]";
+/* Writes 1 if 256 isn't zero then the EOF cell plus one */
+static const char wide[] = "++++++++[>++++++++++++++++++++++++++++++++<-]>"
+			   "[>+<[-]]>.,+.";
+/* Each leaves the tape */
+static const char * off_tape[] = { "+[>+]", "+.[>>>>>>>>+]", "+[<+]", 0 };
+/* The reverse program, but input starting with a '<' leaves the tape */
+static const char lane_src[] =
+    ">,>+<<++++++[>----------<-]>"
+    "[<++++++[>++++++++++<-]>>->,[>,]<[.<]<.[-]]"
+    ">[+[<+]]";
+
+static int failed = 0;
+
+static void
+result(const char * name, const char * what, int ok)
+{
+    printf("%-12s %-32s %s\n", name, what, ok ? "ok" : "FAILED");
+    if (!ok) failed = 1;
+}
+
+static void
+run_init(struct tritium_run * run, const char * input, char * out,
+	size_t outsize)
+{
+    memset(run, 0, sizeof(*run));
+    run->input = input;
+    run->input_len = strlen(input);
+    run->output = out;
+    run->output_size = outsize;
+}
+
+/* The expected output of the reverse program */
+static int
+reversed(const char * in, const char * out, size_t len)
+{
+    size_t i, n = strlen(in);
+
+    if (len != n) return 0;
+    for(i=0; i<n; i++)
+	if (out[i] != in[n-1-i]) return 0;
+    return 1;
+}
+
+static int
+is_reversed(const char * in, const struct tritium_run * run)
+{
+    if (run->error || run->truncated) return 0;
+    return reversed(in, run->output, run->output_len);
+}
+
+/*
+ * Each context keeps its own options; with -b the 256 is zero and -e
+ * makes the EOF cell -1.
+ */
+static void
+check_contexts(void)
+{
+    char * a8[] = { "libcheck", "-b", "-e", 0 };
+    char * aint[] = { "libcheck", "-z", 0 };
+    char * abad[] = { "libcheck", "-batch-jobs", "none", 0 };
+    struct tritium * t8, * tint, * tbad;
+    struct tritium_prog * p8, * pint;
+    struct tritium_run run;
+    char out[8];
+    int ok = 0;
+
+    fprintf(stderr, "The message for a bad option is expected:\n");
+    tbad = tritium_new(3, abad);
+    result("contexts", "a bad option is an error", tbad == 0);
+    tritium_delete(tbad);
+
+    t8 = tritium_new(3, a8);
+    tint = tritium_new(2, aint);
+    p8 = t8 ? tritium_compile(t8, wide) : 0;
+    pint = tint ? tritium_compile(tint, wide) : 0;
+    if (p8 && pint) {
+	/* Twice each, in turn, so nothing is left from the other */
+	int i;
+	ok = 1;
+	for(i=0; i<2; i++) {
+	    run_init(&run, "", out, sizeof(out));
+	    if (!tritium_run(t8, p8, &run) || run.output_len != 2 ||
+		    out[0] != 0 || out[1] != 0)
+		ok = 0;
+	    run_init(&run, "", out, sizeof(out));
+	    if (!tritium_run(tint, pint, &run) || run.output_len != 2 ||
+		    out[0] != 1 || out[1] != 1)
+		ok = 0;
+	}
+    }
+    result("contexts", "each has its own options", ok);
+
+    tritium_free(p8);
+    tritium_free(pint);
+    tritium_delete(t8);
+    tritium_delete(tint);
+}
+
+struct job {
+    struct tritium * t;
+    const struct tritium_prog * prog;
+    int id, ok;
+};
+
+/* Many runs with different inputs, half on a tape that's reused. */
+static void *
+job_thread(void * v)
+{
+    struct job * job = v;
+    struct tritium_tape * tape;
+    struct tritium_run run;
+    char in[64], out[64];
+    int i;
+
+    job->ok = 1;
+    if ((tape = tritium_tape_new(job->t)) == 0) {
+	job->ok = 0;
+	return 0;
+    }
+    for(i=0; i<RUNS; i++) {
+	sprintf(in, "thread %d run %d", job->id, i);
+	run_init(&run, in, out, sizeof(out));
+	if (i & 1) {
+	    if (!tritium_run_tape(job->prog, tape, &run)) job->ok = 0;
+	} else {
+	    if (!tritium_run(job->t, job->prog, &run)) job->ok = 0;
+	}
+	if (!is_reversed(in, &run)) job->ok = 0;
+    }
+    tritium_tape_free(tape);
+    return 0;
+}
+
+static void
+check_threads(struct tritium * t)
+{
+    struct tritium_prog * prog;
+    struct job jobs[THREADS];
+    int i, ok;
+
+    if ((prog = tritium_compile(t, reverse)) == 0) {
+	result("threads", "compile", 0);
+	return;
+    }
+    for(i=0; i<THREADS; i++) {
+	jobs[i].t = t;
+	jobs[i].prog = prog;
+	jobs[i].id = i;
+    }
+
+#ifdef USE_THREADS
+    {
+	pthread_t tid[THREADS];
+	for(i=0; i<THREADS; i++)
+	    if (pthread_create(tid+i, 0, job_thread, jobs+i) != 0) {
+		jobs[i].ok = 0;
+		tid[i] = 0;
+	    }
+	for(i=0; i<THREADS; i++)
+	    if (tid[i]) pthread_join(tid[i], 0);
+    }
+#else
+    for(i=0; i<THREADS; i++)
+	job_thread(jobs+i);
+#endif
+
+    ok = 1;
+    for(i=0; i<THREADS; i++)
+	if (!jobs[i].ok) ok = 0;
+    result("threads", "one program from many threads", ok);
+    tritium_free(prog);
+}
+
+/*
+ * A run that leaves the tape stops with TRITIUM_ETAPE, and the tape is
+ * still good for the next run.
+ */
+static void
+check_bounds(struct tritium * t)
+{
+    struct tritium_prog * prog, * rev;
+    struct tritium_tape * tape;
+    struct tritium_run run;
+    char out[64];
+    int i, ok = 1;
+
+    if ((rev = tritium_compile(t, reverse)) == 0 ||
+	    (tape = tritium_tape_new(t)) == 0) {
+	result("bounds", "compile", 0);
+	tritium_free(rev);
+	return;
+    }
+
+    for(i=0; off_tape[i]; i++) {
+	if ((prog = tritium_compile(t, off_tape[i])) == 0) {
+	    ok = 0;
+	    break;
+	}
+	run_init(&run, "", out, sizeof(out));
+	if (!tritium_run_tape(prog, tape, &run) ||
+		run.error != TRITIUM_ETAPE)
+	    ok = 0;
+	tritium_free(prog);
+
+	run_init(&run, "after", out, sizeof(out));
+	if (!tritium_run_tape(rev, tape, &run) || !is_reversed("after", &run))
+	    ok = 0;
+    }
+    result("bounds", "leaving the tape is an error", ok);
+
+    tritium_tape_free(tape);
+    tritium_free(rev);
+}
+
+/* A loop limit stops the run, and a small buffer sets truncated. */
+static void
+check_limits(struct tritium * t)
+{
+    struct tritium_prog * prog;
+    struct tritium_run run;
+    char out[4];
+    int ok;
+
+    if ((prog = tritium_compile(t, ",[>+<]")) == 0) {
+	result("limits", "compile", 0);
+	return;
+    }
+    run_init(&run, "x", out, sizeof(out));
+    run.loop_limit = 1000;
+    ok = tritium_run(t, prog, &run) && run.error == TRITIUM_ELIMIT;
+    result("limits", "the loop limit stops a run", ok);
+    tritium_free(prog);
+
+    if ((prog = tritium_compile(t, reverse)) == 0) {
+	result("limits", "compile", 0);
+	return;
+    }
+    run_init(&run, "longer than the buffer", out, sizeof(out));
+    ok = tritium_run(t, prog, &run) && run.truncated &&
+	run.output_len == sizeof(out) && memcmp(out, "reff", 4) == 0;
+    result("limits", "the output is truncated", ok);
+    tritium_free(prog);
+}
+
+struct lane {
+    struct tritium_run run;
+    char out[64];
+    char flushed[64];
+    size_t flushed_len;
+    int stop;
+};
+
+/* Keep what's in the buffer, or stop the run. */
+static void
+lane_flush(struct tritium_run * run)
+{
+    struct lane * l = run->user;
+
+    if (l->stop) {
+	run->error = TRITIUM_ESTOP;
+	return;
+    }
+    if (l->flushed_len + run->output_len <= sizeof(l->flushed)) {
+	memcpy(l->flushed + l->flushed_len, run->output, run->output_len);
+	l->flushed_len += run->output_len;
+    }
+    run->output_len = 0;
+}
+
+/*
+ * Most lanes read the same length of input, a few don't, some leave the
+ * tape and some have a small buffer with a flush function.
+ */
+static void
+lane_init(struct lane * l, int i, char * in)
+{
+    if (i % 13 == 5)
+	sprintf(in, "<lane %d", i);
+    else if (i % 7 == 3)
+	sprintf(in, "lane %d with a longer line", i);
+    else
+	sprintf(in, "lane %02d", i);
+
+    memset(l, 0, sizeof(*l));
+    run_init(&l->run, in, l->out, sizeof(l->out));
+    l->run.user = l;
+    if (i % 11 == 4) {
+	l->run.output_size = 4;
+	l->run.flush = lane_flush;
+	l->stop = (i % 2);
+    }
+}
+
+static int
+lane_same(const struct lane * a, const struct lane * b)
+{
+    return a->run.error == b->run.error &&
+	a->run.truncated == b->run.truncated &&
+	a->run.output_len == b->run.output_len &&
+	memcmp(a->out, b->out, a->run.output_len) == 0 &&
+	a->flushed_len == b->flushed_len &&
+	memcmp(a->flushed, b->flushed, a->flushed_len) == 0;
+}
+
+/* Every lane must get what the same run on its own does. */
+static void
+check_lanes(struct tritium * t)
+{
+    static struct lane lanes[LANES], single[LANES];
+    struct tritium_run * runs[LANES];
+    struct tritium_prog * prog;
+    char in[LANES][64];
+    int i, ok, etape = 0, estop = 0, flushed = 0;
+
+    if ((prog = tritium_compile(t, lane_src)) == 0) {
+	result("lanes", "compile", 0);
+	return;
+    }
+
+    ok = 1;
+    for(i=0; i<LANES; i++) {
+	lane_init(single+i, i, in[i]);
+	if (!tritium_run(t, prog, &single[i].run)) ok = 0;
+	switch(single[i].run.error) {
+	case TRITIUM_ETAPE: etape++; break;
+	case TRITIUM_ESTOP: estop++; break;
+	case 0:
+	    if (!single[i].run.flush) {
+		if (!is_reversed(in[i], &single[i].run)) ok = 0;
+	    } else {
+		flushed++;
+		if (single[i].run.output_len != 0 ||
+			!reversed(in[i], single[i].flushed,
+				  single[i].flushed_len))
+		    ok = 0;
+	    }
+	    break;
+	default: ok = 0;
+	}
+    }
+    result("lanes", "single runs", ok && etape && estop && flushed);
+
+    for(i=0; i<LANES; i++) {
+	lane_init(lanes+i, i, in[i]);
+	runs[i] = &lanes[i].run;
+    }
+    ok = tritium_run_lanes(t, prog, runs, LANES);
+    for(i=0; i<LANES; i++)
+	if (!lane_same(lanes+i, single+i)) ok = 0;
+    result("lanes", "the same as single runs", ok);
+
+    tritium_free(prog);
+}
+
+int
+main(int argc, char ** argv)
+{
+    struct tritium * t;
+
+    if ((t = tritium_new(argc, argv)) == 0)
+	return 1;
+
+    check_contexts();
+    check_threads(t);
+    check_bounds(t);
+    check_limits(t);
+    check_lanes(t);
+
+    tritium_delete(t);
+    return failed;
+}
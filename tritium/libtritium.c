@@ -0,0 +1,628 @@
+/*
+ * libtritium; the bfi parser, optimiser and array interpreter as a library.
+ *
+ * A struct tritium is a set of options and the tree they're compiling.
+ * The parser and optimiser still work on bfi's globals, so while a context
+ * is in use its options and tree are swapped into them under a lock and
+ * swapped back out after. The context made by tritium_command() is bfi's
+ * own; its options are the globals, the other engines use them directly.
+ *
+ * tritium_compile() converts the optimised tree into a program array that
+ * belongs to the returned tritium_prog with the cell mask and EOF choice
+ * the run needs. After that nothing global is read or written; a run uses
+ * its own tape and the buffers in the tritium_run.
+ *
+ * An error in the options or the program calls fail_exit(); while a
+ * context is swapped in that longjmp()s back to the library call, which
+ * returns the failure. The message is printed on stderr just as for bfi.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <setjmp.h>
+#if defined(_POSIX_MAPPED_FILES) && ((_POSIX_MAPPED_FILES -0) > 0)
+#include <sys/mman.h>
+#endif
+
+/* DO_PTHREAD= in the makefile sets DISABLE_PTHREAD */
+#if !defined(DISABLE_PTHREAD) && defined(_POSIX_THREADS)
+#if _POSIX_THREADS > 0
+#define USE_LOCK
+#include <pthread.h>
+#endif
+#endif
+
+#include "bfi.tree.h"
+#include "bfi.run.h"
+#include "bfi.runarray.h"
+#include "libtritium.h"
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#if defined(MAP_ANONYMOUS) && defined(MADV_DONTNEED) && !defined(DISABLE_MADVISE)
+#define USE_MADVISE
+#endif
+
+/* The bfi globals that are a context's options and its tree. */
+#define TRITIUM_STATE(X) \
+    X(int, verbose) X(int, noheader) X(int, rle_input) X(int, do_run)	\
+    X(int, debug_mode) X(int, enable_trace) X(int, iostyle)		\
+    X(int, default_io) X(int, eofcell) X(int, opt_level)		\
+    X(int, opt_runner) X(int, opt_no_calc) X(int, opt_no_litprt)	\
+    X(int, opt_no_endif) X(int, opt_no_kv_recursion)			\
+    X(int, opt_no_loop_classify) X(int, opt_no_kvmov)			\
+    X(int, opt_regen_mov) X(int, opt_pointerrescan)			\
+    X(int, opt_loop_counters) X(int, hard_left_limit) X(int, memsize)	\
+    X(unsigned, cell_length) X(int, cell_size) X(int, cell_mask)	\
+    X(int, cell_smask) X(char const *, cell_type) X(int, cell_type_iso)	\
+    X(struct bfi *, bfprog) X(int, total_nodes)
+
+#define X_EXTERN(type, name) extern type name;
+TRITIUM_STATE(X_EXTERN)
+#undef X_EXTERN
+
+struct tritium_state {
+#define X_FIELD(type, name) type name;
+    TRITIUM_STATE(X_FIELD)
+#undef X_FIELD
+};
+
+struct tritium {
+    struct tritium_state opts;	/* Not used for bfi's own context */
+    int command;		/* This is bfi's own, the globals are its */
+    int tape_slack;		/* See tritium_tape_new() */
+};
+
+/* A context's option, the lock must be held. */
+#define T_OPT(t, name) ((t)->command ? (name) : (t)->opts.name)
+
+struct tritium_prog {
+    int * progarray;
+    size_t cells;		/* Tape length including the margin */
+    int margin;			/* Cells to the left of the start */
+    int slack;			/* Cells an op can reach past the pointer */
+    int mask, eof;		/* The cell_mask and eofcell for the run */
+};
+
+struct tritium_tape {
+    char * base;
+    size_t len;			/* Bytes mapped */
+    size_t page;
+    size_t cells;
+    int margin;
+};
+
+#ifdef USE_LOCK
+static pthread_mutex_t compile_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK()	    pthread_mutex_lock(&compile_lock)
+#define UNLOCK()    pthread_mutex_unlock(&compile_lock)
+#else
+#define LOCK()
+#define UNLOCK()
+#endif
+
+static jmp_buf * trap = 0;
+
+static void
+state_get(struct tritium_state * s)
+{
+#define X_GET(type, name) s->name = name;
+    TRITIUM_STATE(X_GET)
+#undef X_GET
+}
+
+static void
+state_put(const struct tritium_state * s)
+{
+#define X_PUT(type, name) name = s->name;
+    TRITIUM_STATE(X_PUT)
+#undef X_PUT
+}
+
+static void
+trap_fail(void)
+{
+    longjmp(*trap, 1);
+}
+
+/*
+ * Take the lock and swap the context in, the globals are kept in saved.
+ * Until leave() a fail_exit() goes to the caller's setjmp() on jb.
+ */
+static void
+enter(struct tritium * t, struct tritium_state * saved, jmp_buf * jb)
+{
+    LOCK();
+    if (!t->command) {
+	state_get(saved);
+	state_put(&t->opts);
+    }
+    trap = jb;
+    fail_hook = trap_fail;
+}
+
+static void
+leave(struct tritium * t, const struct tritium_state * saved)
+{
+    fail_hook = 0;
+    trap = 0;
+    if (!t->command) {
+	state_get(&t->opts);
+	state_put(saved);
+    }
+    UNLOCK();
+}
+
+/*
+ * The pointer is only checked at loops and searches, between them it can
+ * be moved by the ops and each op can use cells either side of it. This is
+ * how far that can be from the last check; twice it is always enough.
+ */
+static int
+tree_slack(void)
+{
+    struct bfi * n;
+    int s = 0, pos = 0, v, i;
+
+    for(n = bfprog; n; n = n->next) {
+	switch(n->type) {
+	case T_WHL: case T_IF: case T_MULT: case T_CMULT: case T_END:
+	    pos = 0;
+	    break;
+	case T_MOV:
+	    pos += n->count;
+	    continue;
+	}
+	for(i=0; i<3; i++) {
+	    v = pos + (i==0 ? n->offset : i==1 ? n->offset2 : n->offset3);
+	    if (v < 0) v = -v;
+	    if (v > s) s = v;
+	    if (n->type != T_CALC) break;
+	}
+    }
+    return s*2 + 1;
+}
+
+static struct tritium *
+context_new(int command)
+{
+    struct tritium * t;
+
+    if ((t = calloc(1, sizeof(*t))) == 0) return 0;
+    t->command = command;
+    /* Big enough that a tape is rarely too small for a later program. */
+    t->tape_slack = 4096;
+    if (!command) {
+	LOCK();
+	state_get(&t->opts);
+	UNLOCK();
+    }
+    return t;
+}
+
+/*
+ * A context with the options in argv, argv[0] is ignored. It starts with
+ * bfi's defaults, or in bfi itself the command line's options. Only the
+ * array interpreter is used so the cells must fit in an int. Returns NULL
+ * if the options are bad.
+ */
+struct tritium *
+tritium_new(int argc, char ** argv)
+{
+    struct tritium * volatile t;
+    struct tritium_state saved;
+    jmp_buf jb;
+    int ok;
+
+    if ((t = context_new(0)) == 0) return 0;
+
+    enter(t, &saved, &jb);
+    if (setjmp(jb)) {
+	leave(t, &saved);
+	free(t);
+	return 0;
+    }
+    process_args(argc, argv, 0);
+    do_run = 1;
+    opt_runner = 0;
+    if (cell_length == 0)
+	set_cell_size(-1);
+    ok = (cell_size > 0);
+    leave(t, &saved);
+
+    if (!ok) {
+	fprintf(stderr, "The library needs cells that fit in an int.\n");
+	free(t);
+	return 0;
+    }
+    return t;
+}
+
+/*
+ * The context for the bfi command; its options and tree are the globals
+ * the other engines use. The arguments that aren't options are put in
+ * filelist and counted in *filecount. Returns NULL if the options are bad.
+ */
+struct tritium *
+tritium_command(int argc, char ** argv, const char ** filelist, int * filecount)
+{
+    struct tritium * volatile t;
+    struct tritium_state saved;
+    jmp_buf jb;
+
+    if ((t = context_new(1)) == 0) return 0;
+
+    enter(t, &saved, &jb);
+    if (setjmp(jb)) {
+	leave(t, &saved);
+	free(t);
+	return 0;
+    }
+    *filecount = process_args(argc, argv, filelist);
+    leave(t, &saved);
+    return t;
+}
+
+void
+tritium_delete(struct tritium * t)
+{
+    free(t);
+}
+
+/*
+ * Load the files, "-" is stdin, or if there are none the source string
+ * into the context's tree. Returns zero if a file can't be read.
+ */
+int
+tritium_load(struct tritium * t, const char ** files, int nfiles,
+	const char * source)
+{
+    struct tritium_state saved;
+    jmp_buf jb;
+    FILE * volatile ifd = 0;
+    int i;
+
+    enter(t, &saved, &jb);
+    if (setjmp(jb)) {
+	if (ifd && ifd != stdin) fclose(ifd);
+	delete_tree();
+	leave(t, &saved);
+	return 0;
+    }
+    delete_tree();
+    for(i=0; i<nfiles; i++) {
+	if (strcmp(files[i], "-") == 0)
+	    ifd = stdin;
+	else if ((ifd = fopen(files[i], "r")) == 0) {
+	    perror(files[i]);
+	    fail_exit(1);
+	}
+	load_file(ifd, i==0, i+1>=nfiles, 0);
+	if (ifd != stdin) fclose(ifd);
+	ifd = 0;
+    }
+    if (nfiles == 0 && source)
+	load_file(0, 1, 1, (char*)source);
+    leave(t, &saved);
+    return 1;
+}
+
+/* Optimise the context's tree; returns zero if that fails. */
+int
+tritium_optimise(struct tritium * t)
+{
+    struct tritium_state saved;
+    jmp_buf jb;
+
+    enter(t, &saved, &jb);
+    if (setjmp(jb)) {
+	delete_tree();
+	leave(t, &saved);
+	return 0;
+    }
+    optimise_tree();
+    leave(t, &saved);
+    return 1;
+}
+
+/*
+ * Compile the program with the context's options. Returns NULL if it
+ * can't be compiled for the array interpreter.
+ */
+struct tritium_prog *
+tritium_compile(struct tritium * t, const char * source)
+{
+    struct tritium_prog * volatile prog;
+    struct tritium_state saved;
+    jmp_buf jb;
+    int saved_memsize;
+
+    if ((prog = calloc(1, sizeof(*prog))) == 0) return 0;
+
+    enter(t, &saved, &jb);
+    saved_memsize = memsize;
+    if (setjmp(jb)) {
+	delete_tree();
+	memsize = saved_memsize;
+	leave(t, &saved);
+	free(prog->progarray);
+	free(prog);
+	return 0;
+    }
+    delete_tree();
+    load_file(0, 1, 1, (char*)source);
+    optimise_tree();
+    prog->progarray = runarray_program();
+    prog->margin = -hard_left_limit;
+    /* Not the smaller memsize the optimiser may prove, a T_CHR can be
+     * further on than any cell that is used. */
+    prog->cells = (size_t)saved_memsize + (size_t)prog->margin;
+    prog->slack = tree_slack();
+    prog->mask = cell_mask;
+    prog->eof = eofcell;
+    if (prog->slack > t->tape_slack) t->tape_slack = prog->slack;
+    delete_tree();
+    memsize = saved_memsize;
+    leave(t, &saved);
+
+    if (!prog->progarray) {
+	free(prog);
+	return 0;
+    }
+    return prog;
+}
+
+/*
+ * A tape for running programs on. It's anonymous memory so after a run the
+ * pages that mincore() says have been touched are given back with
+ * madvise(), they're zero the next time they're used.
+ *
+ * The cells and margin include the slack at each end; the pointer never
+ * goes there but an op with an offset can.
+ */
+static struct tritium_tape *
+tape_new(size_t cells, int margin)
+{
+    struct tritium_tape * tape;
+
+    if ((tape = calloc(1, sizeof(*tape))) == 0) return 0;
+    tape->margin = margin;
+    tape->cells = cells;
+    tape->len = tape->cells * sizeof(int);
+#ifdef USE_MADVISE
+    tape->page = (size_t)sysconf(_SC_PAGESIZE);
+    tape->len = (tape->len + tape->page-1) / tape->page * tape->page;
+    tape->base = mmap(0, tape->len, PROT_READ|PROT_WRITE,
+		MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (tape->base == MAP_FAILED) tape->base = 0;
+#else
+    tape->base = calloc(tape->cells, sizeof(int));
+#endif
+    if (!tape->base) {
+	free(tape);
+	return 0;
+    }
+    return tape;
+}
+
+/*
+ * A tape for the context's programs; the slack at each end is the most any
+ * program compiled so far needs, but at least the guess context_new() makes.
+ */
+struct tritium_tape *
+tritium_tape_new(struct tritium * t)
+{
+    size_t cells;
+    int margin;
+
+    LOCK();
+    margin = -T_OPT(t, hard_left_limit) + t->tape_slack;
+    cells = (size_t)T_OPT(t, memsize) + (size_t)margin + (size_t)t->tape_slack;
+    UNLOCK();
+    return tape_new(cells, margin);
+}
+
+void
+tritium_tape_free(struct tritium_tape * tape)
+{
+    if (!tape) return;
+#ifdef USE_MADVISE
+    munmap(tape->base, tape->len);
+#else
+    free(tape->base);
+#endif
+    free(tape);
+}
+
+/* Which pages of the tape have been touched, NULL if it's not known. */
+static unsigned char *
+tape_resident(struct tritium_tape * tape)
+{
+#ifdef USE_MADVISE
+    unsigned char * vec = malloc(tape->len / tape->page);
+    if (vec && mincore(tape->base, tape->len, (void*)vec) == 0)
+	return vec;
+    free(vec);
+#else
+    (void)tape;
+#endif
+    return 0;
+}
+
+static void
+tape_reset(struct tritium_tape * tape)
+{
+#ifdef USE_MADVISE
+    size_t pg = tape->page, pages = tape->len / pg, lo, hi;
+    unsigned char * vec = tape_resident(tape);
+
+    if (vec) {
+	for(lo=0; lo<pages && !(vec[lo]&1); lo++);
+	for(hi=pages; hi>lo && !(vec[hi-1]&1); hi--);
+	if (hi > lo)
+	    madvise(tape->base + lo*pg, (hi-lo)*pg, MADV_DONTNEED);
+    } else
+	madvise(tape->base, tape->len, MADV_DONTNEED);
+    free(vec);
+#else
+    memset(tape->base, 0, tape->cells * sizeof(int));
+#endif
+}
+
+/*
+ * Run the program on the tape; returns zero if the tape is too small for
+ * the program. Any output left in the buffer is given to the flush
+ * function at the end.
+ */
+int
+tritium_run_tape(const struct tritium_prog * prog,
+	struct tritium_tape * tape, struct tritium_run * run)
+{
+    if (prog->margin + prog->slack > tape->margin ||
+	    prog->cells - (size_t)prog->margin + (size_t)prog->slack >
+	    tape->cells - (size_t)tape->margin)
+	return 0;
+
+    run->output_len = 0;
+    run->truncated = 0;
+    runarray_run(prog->progarray,
+	    (int*)tape->base + tape->margin - prog->margin,
+	    prog->cells, prog->margin, prog->mask, prog->eof, run);
+    if (run->flush && run->output_len)
+	run->flush(run);
+    tape_reset(tape);
+    return 1;
+}
+
+/* Run the program on a new tape; returns zero if it can't be allocated. */
+int
+tritium_run(struct tritium * t, const struct tritium_prog * prog,
+	struct tritium_run * run)
+{
+    struct tritium_tape * tape;
+    int rv;
+
+    if ((tape = tritium_tape_new(t)) == 0) return 0;
+    rv = tritium_run_tape(prog, tape, run);
+    tritium_tape_free(tape);
+    return rv;
+}
+
+struct lane_ctx {
+    const struct tritium_prog * prog;
+    struct tritium_tape * lanes, * tape;
+    struct tritium_run ** runs;
+};
+
+/*
+ * The lane has gone its own way; copy its cells to a normal tape and let
+ * the array interpreter finish it. Pages of the lane tape that were never
+ * touched are skipped.
+ */
+static void
+lane_eject(void * vctx, int lane, int * p, long cell)
+{
+    struct lane_ctx * ctx = vctx;
+    int * lanes = (int*)ctx->lanes->base;
+    int * s;
+    size_t i, end, blk = RUNARRAY_LANES * sizeof(int);
+    unsigned char * vec;
+    struct tritium_run * run = ctx->runs[lane];
+    const struct tritium_prog * prog = ctx->prog;
+
+    s = (int*)ctx->tape->base + ctx->tape->margin - prog->margin - prog->slack;
+
+    vec = tape_resident(ctx->lanes);
+    end = prog->cells + (size_t)prog->slack*2;
+    for(i=0; i<end; ) {
+	if (vec && !(vec[i*blk / ctx->lanes->page] & 1)) {
+	    i = (i*blk / ctx->lanes->page + 1) * ctx->lanes->page / blk;
+	    continue;
+	}
+	s[i] = lanes[i*RUNARRAY_LANES + (size_t)lane];
+	i++;
+    }
+    free(vec);
+
+    s += prog->slack;
+    runarray_run(p, s, prog->cells, prog->margin + cell,
+	    prog->mask, prog->eof, run);
+    if (run->flush && run->output_len)
+	run->flush(run);
+    tape_reset(ctx->tape);
+}
+
+/*
+ * Run the program once for each of the n runs, RUNARRAY_LANES at a time
+ * in lockstep. A group of less than RUNARRAY_LANES_MIN is run one at a
+ * time, the lane tape is only made if there's a bigger group. The lanes
+ * don't count loops so if any run has a limit they're all run one at a
+ * time. Returns zero if the tapes can't be allocated.
+ */
+int
+tritium_run_lanes(struct tritium * t, const struct tritium_prog * prog,
+	struct tritium_run ** runs, int n)
+{
+    struct lane_ctx ctx;
+    int i, g, cnt, rv = 1, single = 0;
+
+    ctx.prog = prog;
+    ctx.runs = 0;
+    ctx.tape = 0;
+    ctx.lanes = 0;
+
+    for(i=0; i<n; i++) {
+	runs[i]->output_len = 0;
+	runs[i]->truncated = 0;
+	runs[i]->error = 0;
+	if (runs[i]->loop_limit || runs[i]->time_limit > 0)
+	    single = 1;
+    }
+
+    for(g=0; g<n && rv; g+=RUNARRAY_LANES) {
+	cnt = n-g < RUNARRAY_LANES ? n-g : RUNARRAY_LANES;
+	ctx.runs = runs+g;
+	/* The lanes that go their own way are finished on this tape. */
+	if (!ctx.tape && (ctx.tape = tritium_tape_new(t)) == 0) {
+	    rv = 0;
+	    break;
+	}
+	if (cnt < RUNARRAY_LANES_MIN || single) {
+	    for(i=0; i<cnt && rv; i++)
+		rv = tritium_run_tape(prog, ctx.tape, ctx.runs[i]);
+	    continue;
+	}
+	if (!ctx.lanes) {
+	    ctx.lanes = tape_new(
+		    (prog->cells + (size_t)prog->slack*2) * RUNARRAY_LANES,
+		    (prog->margin + prog->slack) * RUNARRAY_LANES);
+	    if (!ctx.lanes) {
+		rv = 0;
+		break;
+	    }
+	}
+	runarray_lanes(prog->progarray,
+		(int*)ctx.lanes->base + prog->slack * RUNARRAY_LANES,
+		prog->cells, prog->margin, prog->mask, prog->eof,
+		cnt, ctx.runs, lane_eject, &ctx);
+	for(i=0; i<cnt; i++)
+	    if (ctx.runs[i]->flush && ctx.runs[i]->output_len)
+		ctx.runs[i]->flush(ctx.runs[i]);
+	tape_reset(ctx.lanes);
+    }
+
+    tritium_tape_free(ctx.lanes);
+    tritium_tape_free(ctx.tape);
+    return rv;
+}
+
+void
+tritium_free(struct tritium_prog * prog)
+{
+    if (!prog) return;
+    free(prog->progarray);
+    free(prog);
+}
@@ -0,0 +1,78 @@
+/*
+ * libtritium; compile a BF program once then run it many times.
+ *
+ * A struct tritium holds the options, the same as the bfi command line,
+ * from tritium_new(). Each context keeps its own; compiles are serialised
+ * but a compiled program is read only so any number of threads can run it
+ * at the same time. Every run has its own tape and the caller's input and
+ * output.
+ *
+ * A tape from tritium_tape_new() can be used for one run after another,
+ * only the pages the last run touched are cleared. It's sized for the
+ * programs the context has compiled so far; tritium_run_tape() returns
+ * zero if a later program needs a bigger one.
+ *
+ * With tritium_run_lanes() a batch of inputs are run in lockstep on one
+ * interleaved tape; this is quicker when the runs mostly take the same
+ * path through the program. Runs that go their own way, and batches of
+ * only a few, are finished one at a time.
+ *
+ * A run whose pointer leaves the tape stops with its error set; the other
+ * runs and the caller carry on. So does a run that reaches its loop or
+ * time limit; runs with a limit aren't put in lanes.
+ *
+ * Bad options or a program that can't be compiled print a message on
+ * stderr and the call returns NULL; nothing exits.
+ */
+
+#include <stddef.h>
+
+struct tritium;
+struct tritium_prog;
+struct tritium_tape;
+
+struct tritium_run {
+    const char * input;		/* Input bytes for ',' */
+    size_t input_len, input_pos;
+    char * output;		/* Output from '.' */
+    size_t output_size, output_len;
+    int truncated;		/* Set if the output didn't fit */
+    int error;			/* Why the run stopped early */
+    unsigned long long loop_limit; /* If set, the most loop back-edges */
+    double time_limit;		/* If set, the most seconds to run for */
+    /* If set, called to empty the output buffer when it's full; it can
+     * set the error to TRITIUM_ESTOP to end the run. */
+    void (*flush)(struct tritium_run * run);
+    void * user;
+};
+
+/* The error of a run that stopped early. */
+#define TRITIUM_ETAPE	1	/* The pointer left the tape */
+#define TRITIUM_ELIMIT	2	/* The loop or time limit was reached */
+#define TRITIUM_ESTOP	3	/* The flush function stopped it */
+
+struct tritium * tritium_new(int argc, char ** argv);
+void tritium_delete(struct tritium * t);
+
+struct tritium_prog * tritium_compile(struct tritium * t, const char * source);
+int tritium_run(struct tritium * t, const struct tritium_prog * prog,
+	struct tritium_run * run);
+void tritium_free(struct tritium_prog * prog);
+
+struct tritium_tape * tritium_tape_new(struct tritium * t);
+int tritium_run_tape(const struct tritium_prog * prog,
+	struct tritium_tape * tape, struct tritium_run * run);
+void tritium_tape_free(struct tritium_tape * tape);
+
+int tritium_run_lanes(struct tritium * t, const struct tritium_prog * prog,
+	struct tritium_run ** runs, int n);
+
+/*
+ * For bfi itself; the context is the command line's and its tree is the
+ * one the other engines use. Zero or NULL is returned for an error.
+ */
+struct tritium * tritium_command(int argc, char ** argv,
+	const char ** filelist, int * filecount);
+int tritium_load(struct tritium * t, const char ** files, int nfiles,
+	const char * source);
+int tritium_optimise(struct tritium * t);
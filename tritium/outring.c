@@ -0,0 +1,215 @@
+/*
+ * Asynchronous output for -fasync-output.
+ *
+ * The running program puts its output into a single producer, single
+ * consumer ring buffer and a writer thread drains it with large write()
+ * calls, so a slow reader on stdout doesn't stop the program until the
+ * ring is full.
+ *
+ * The head index belongs to the program and the tail to the writer, the
+ * data path doesn't lock. The mutex and conditions are only used when
+ * one side has to sleep. The writer is woken when a block of output is
+ * waiting and otherwise polls every few milliseconds so a slow trickle
+ * of output still appears.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+
+#if !defined(DISABLE_OUTRING) && defined(_POSIX_THREADS) && defined(__ATOMIC_ACQUIRE)
+#if _POSIX_THREADS > 0
+#define USE_OUTRING
+#include <pthread.h>
+#include <time.h>
+#endif
+#endif
+
+#include "outring.h"
+#include "clock.h"
+
+int outring_active = 0;
+
+#ifdef USE_OUTRING
+#define RINGSIZE    (1UL<<20)
+#define RINGMASK    (RINGSIZE-1)
+#define RINGWAKE    4096	/* Wake the writer every this many bytes */
+#define RINGPOLL    5		/* Milliseconds between polls of the ring */
+
+#define load_acq(x)	__atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define store_rel(x,v)	__atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#define load_sc(x)	__atomic_load_n(&(x), __ATOMIC_SEQ_CST)
+#define store_sc(x,v)	__atomic_store_n(&(x), (v), __ATOMIC_SEQ_CST)
+
+static char * ring = 0;
+static size_t ring_head = 0, ring_tail = 0;
+static int ring_stop = 0, ring_error = 0;
+static int writer_idle = 0, producer_waiting = 0;
+
+static pthread_t writer;
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ring_data = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ring_space = PTHREAD_COND_INITIALIZER;
+
+static void *
+writer_thread(void * unused)
+{
+    size_t t = ring_tail, h, len;
+    ssize_t w;
+
+    (void)unused;
+    for(;;) {
+	h = load_acq(ring_head);
+	if (h == t) {
+	    pthread_mutex_lock(&ring_lock);
+	    store_sc(writer_idle, 1);
+	    pthread_cond_broadcast(&ring_space);
+	    while ((h = load_acq(ring_head)) == t && !ring_stop) {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += RINGPOLL * 1000000L;
+		if (ts.tv_nsec >= 1000000000L)
+		    { ts.tv_nsec -= 1000000000L; ts.tv_sec++; }
+		pthread_cond_timedwait(&ring_data, &ring_lock, &ts);
+	    }
+	    store_sc(writer_idle, 0);
+	    pthread_mutex_unlock(&ring_lock);
+	    if (h == t) break;
+	}
+
+	/* Upto the end of the ring, the rest will be next time round. */
+	len = h - t;
+	if (len > RINGSIZE - (t & RINGMASK))
+	    len = RINGSIZE - (t & RINGMASK);
+
+	w = write(1, ring + (t & RINGMASK), len);
+	if (w < 0) {
+	    if (errno == EINTR || errno == EAGAIN) continue;
+	    if (!ring_error) perror("Writing output");
+	    ring_error = 1;
+	    w = (ssize_t)len;	/* Discard it */
+	}
+	t += (size_t)w;
+	store_sc(ring_tail, t);
+
+	if (load_sc(producer_waiting)) {
+	    pthread_mutex_lock(&ring_lock);
+	    pthread_cond_broadcast(&ring_space);
+	    pthread_mutex_unlock(&ring_lock);
+	}
+    }
+    return 0;
+}
+
+static void
+wake_writer(void)
+{
+    if (!load_sc(writer_idle)) return;
+    pthread_mutex_lock(&ring_lock);
+    pthread_cond_signal(&ring_data);
+    pthread_mutex_unlock(&ring_lock);
+}
+
+/*
+ * Wait until there are at most 'used' bytes in the ring; the time spent
+ * waiting is counted as I/O time.
+ */
+static void
+wait_for_writer(size_t used)
+{
+    pause_runclock();
+    pthread_mutex_lock(&ring_lock);
+    store_sc(producer_waiting, 1);
+    pthread_cond_signal(&ring_data);
+    while (ring_head - load_sc(ring_tail) > used && !ring_error)
+	pthread_cond_wait(&ring_space, &ring_lock);
+    store_sc(producer_waiting, 0);
+    pthread_mutex_unlock(&ring_lock);
+    unpause_runclock();
+}
+
+void
+outring_putc(int ch)
+{
+    size_t h = ring_head;
+    if (h - load_acq(ring_tail) >= RINGSIZE)
+	wait_for_writer(RINGSIZE-1);
+    ring[h & RINGMASK] = (char)ch;
+    store_rel(ring_head, h+1);
+    if (((h+1) & (RINGWAKE-1)) == 0)
+	wake_writer();
+}
+
+void
+outring_write(const char * s, size_t len)
+{
+    size_t h = ring_head, i;
+    if (len > RINGSIZE || h - load_acq(ring_tail) > RINGSIZE - len) {
+	while(len--) outring_putc(*s++);
+	return;
+    }
+    for(i=0; i<len; i++)
+	ring[(h+i) & RINGMASK] = s[i];
+    store_rel(ring_head, h+len);
+    if ((h & ~(size_t)(RINGWAKE-1)) != ((h+len) & ~(size_t)(RINGWAKE-1)))
+	wake_writer();
+}
+
+void
+flush_outring(void)
+{
+    if (!outring_active) return;
+    if (ring_head != load_acq(ring_tail))
+	wait_for_writer(0);
+}
+
+void
+stop_outring(void)
+{
+    if (!outring_active) return;
+    flush_outring();
+    pthread_mutex_lock(&ring_lock);
+    ring_stop = 1;
+    pthread_cond_signal(&ring_data);
+    pthread_mutex_unlock(&ring_lock);
+    pthread_join(writer, 0);
+    outring_active = 0;
+    free(ring);
+    ring = 0;
+}
+
+int
+start_outring(void)
+{
+    static int atexit_done = 0;
+    if (outring_active) return 1;
+
+    /* Anything already in stdio goes first. */
+    fflush(stdout);
+
+    if (!(ring = malloc(RINGSIZE))) return 0;
+    ring_head = ring_tail = 0;
+    ring_stop = ring_error = 0;
+    writer_idle = producer_waiting = 0;
+
+    if (pthread_create(&writer, 0, writer_thread, 0) != 0) {
+	free(ring);
+	ring = 0;
+	return 0;
+    }
+    outring_active = 1;
+    if (!atexit_done) {
+	atexit(stop_outring);
+	atexit_done = 1;
+    }
+    return 1;
+}
+
+#else
+int start_outring(void) { return 0; }
+void stop_outring(void) { }
+void flush_outring(void) { }
+void outring_putc(int ch) { putchar(ch); }
+void outring_write(const char * s, size_t len) { fwrite(s, 1, len, stdout); }
+#endif
@@ -0,0 +1,8 @@
+
+extern int outring_active;
+
+int start_outring(void);
+void stop_outring(void);
+void flush_outring(void);
+void outring_putc(int ch);
+void outring_write(const char * s, size_t len);
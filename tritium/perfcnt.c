@@ -0,0 +1,198 @@
+/*
+ * Hardware performance counters for -fperf-counters.
+ *
+ * The counters are opened with perf_event_open() just before the run and
+ * the run clock enables and disables them, so only the execution of the
+ * program is counted, not the parse, optimisation or code generation.
+ *
+ * Cycles, instructions and branch misses are one group so the IPC is
+ * measured over exactly the same time; the cache and TLB misses are a
+ * second group because the PMU may not have enough counters for all of
+ * them at once. Any group the kernel has to multiplex is scaled up.
+ *
+ * Only user space is counted which the default perf_event_paranoid
+ * allows. If there's no PMU (many VMs and containers) or the counters are
+ * not permitted the program runs without them.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#if !defined(DISABLE_PERFCNT) && defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#if defined(__NR_perf_event_open) && defined(PERF_EVENT_IOC_ENABLE)
+#define USE_PERFCNT
+#endif
+#endif
+
+#include "perfcnt.h"
+
+int perfcnt_active = 0;
+
+#ifdef USE_PERFCNT
+#define HWC(x)	    PERF_TYPE_HARDWARE, PERF_COUNT_HW_##x
+#define CACHE(x)    PERF_TYPE_HW_CACHE, (PERF_COUNT_HW_CACHE_##x | \
+			(PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+			(PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct counter {
+    const char * name;
+    int group;
+    unsigned type;
+    unsigned long long config;
+} counters[] = {
+    { "cycles",			0, HWC(CPU_CYCLES) },
+    { "instructions",		0, HWC(INSTRUCTIONS) },
+    { "branch-misses",		0, HWC(BRANCH_MISSES) },
+    { "L1-dcache-load-misses",	1, CACHE(L1D) },
+    { "LLC-load-misses",	1, CACHE(LL) },
+    { "dTLB-load-misses",	1, CACHE(DTLB) },
+};
+#define NCOUNTERS   ((int)(sizeof(counters)/sizeof(*counters)))
+#define NGROUPS	    2
+
+static int leader[NGROUPS];
+static int fd[NCOUNTERS], ok[NCOUNTERS];
+static double value[NCOUNTERS];
+
+static int
+perf_event_open(struct perf_event_attr * attr, int group_fd)
+{
+    return (int)syscall(__NR_perf_event_open, attr, 0, -1, group_fd, 0);
+}
+
+static void
+perfcnt_ioctl(unsigned long req)
+{
+    int g;
+    for(g=0; g<NGROUPS; g++)
+	if (leader[g] >= 0)
+	    ioctl(leader[g], req, PERF_IOC_FLAG_GROUP);
+}
+
+int
+perfcnt_open(void)
+{
+    struct perf_event_attr pe;
+    int i, g;
+
+    if (perfcnt_active) {
+	perfcnt_ioctl(PERF_EVENT_IOC_RESET);
+	return 1;
+    }
+
+    for(g=0; g<NGROUPS; g++) leader[g] = -1;
+
+    for(i=0; i<NCOUNTERS; i++) {
+	g = counters[i].group;
+	memset(&pe, 0, sizeof(pe));
+	pe.size = sizeof(pe);
+	pe.type = counters[i].type;
+	pe.config = counters[i].config;
+	pe.disabled = (leader[g] < 0);
+	pe.exclude_kernel = 1;
+	pe.exclude_hv = 1;
+	pe.read_format = PERF_FORMAT_GROUP |
+	    PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	fd[i] = perf_event_open(&pe, leader[g]);
+	if (fd[i] < 0) {
+	    /* Without cycles there's nothing worth reporting. */
+	    if (i == 0) return 0;
+	    continue;
+	}
+	if (leader[g] < 0) leader[g] = fd[i];
+    }
+
+    perfcnt_active = 1;
+    return 1;
+}
+
+void
+perfcnt_enable(void)
+{
+    perfcnt_ioctl(PERF_EVENT_IOC_ENABLE);
+}
+
+void
+perfcnt_disable(void)
+{
+    perfcnt_ioctl(PERF_EVENT_IOC_DISABLE);
+}
+
+static void
+perfcnt_read(void)
+{
+    unsigned long long buf[3+NCOUNTERS];
+    int i, g, n;
+    double scale;
+
+    for(i=0; i<NCOUNTERS; i++) ok[i] = 0;
+
+    for(g=0; g<NGROUPS; g++) {
+	if (leader[g] < 0) continue;
+	if (read(leader[g], buf, sizeof(buf)) < (ssize_t)(3*sizeof(*buf)))
+	    continue;
+	/* Not scheduled at all; the group is too big for this PMU. */
+	if (buf[2] == 0) continue;
+	scale = (double)buf[1] / (double)buf[2];
+
+	for(n=0, i=0; i<NCOUNTERS && n<(int)buf[0]; i++) {
+	    if (counters[i].group != g || fd[i] < 0) continue;
+	    value[i] = (double)buf[3+n] * scale;
+	    ok[i] = 1;
+	    n++;
+	}
+    }
+}
+
+/*
+ * Print the counters; if the number of BF commands run is known the cost
+ * of each is printed too.
+ */
+void
+perfcnt_report(double bf_ops)
+{
+    int i;
+
+    if (!perfcnt_active) return;
+    perfcnt_read();
+
+    for(i=0; i<NCOUNTERS; i++) {
+	if (!ok[i]) continue;
+	if (bf_ops > 0)
+	    fprintf(stderr, "%16.0f  %-22s %10.3f per BF op\n",
+		value[i], counters[i].name, value[i] / bf_ops);
+	else
+	    fprintf(stderr, "%16.0f  %s\n", value[i], counters[i].name);
+    }
+
+    if (ok[0] && ok[1] && value[0] > 0)
+	fprintf(stderr, "%16.3f  instructions per cycle\n",
+	    value[1] / value[0]);
+}
+
+/*
+ * The i'th counter after perfcnt_report(); returns -1 past the end and
+ * zero if the counter wasn't available.
+ */
+int
+perfcnt_get(int i, const char ** name, double * v)
+{
+    if (!perfcnt_active || i < 0 || i >= NCOUNTERS) return -1;
+    *name = counters[i].name;
+    *v = value[i];
+    return ok[i];
+}
+
+#else
+int perfcnt_get(int i, const char ** name, double * v)
+{ (void)i; (void)name; (void)v; return -1; }
+int perfcnt_open(void) { return 0; }
+void perfcnt_enable(void) { }
+void perfcnt_disable(void) { }
+void perfcnt_report(double bf_ops) { (void)bf_ops; }
+#endif
@@ -0,0 +1,8 @@
+
+extern int perfcnt_active;
+
+int perfcnt_open(void);
+void perfcnt_enable(void);
+void perfcnt_disable(void);
+void perfcnt_report(double bf_ops);
+int perfcnt_get(int i, const char ** name, double * v);
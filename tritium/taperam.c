@@ -11,6 +11,12 @@
 #include <sys/mman.h>
 #include <signal.h>
 #endif
+#if _POSIX_VERSION >= 200112L
+#include <sys/resource.h>
+#endif
+#ifdef __linux__
+#include <string.h>
+#endif
 
 #include "bfi.tree.h"
 #include "bfi.run.h"
@@ -23,6 +29,11 @@
 
 /* Where's the tape memory start */
 char * cell_array_pointer = 0;
+/* -fhugepage (the default), -fhugetlb and -fprefault */
+int opt_hugepage = 1;
+int opt_prefault = 0;
+/* -tapesize, in bytes; zero gives the default size. */
+size_t tape_mem_size = 0;
 /* Location of all of the tape memory. */
 char * cell_array_low_addr = 0;
 size_t cell_array_alloc_len = 0;
@@ -31,6 +42,7 @@ size_t cell_array_alloc_len = 0;
 #define MEMSIZE	    2UL*1024*1024*1024
 #define MEMGUARD    16UL*1024*1024
 #define MEMSKIP	    1UL*1024*1024
+#define HUGESIZE    2UL*1024*1024
 
 #ifndef MAP_NORESERVE
 #define MAP_NORESERVE 0
@@ -75,6 +87,13 @@ unmap_hugeram(void)
     cell_array_low_addr = 0;
     cell_array_alloc_len = 0;
 }
+
+size_t
+tape_span(char ** lo)
+{
+    *lo = cell_array_low_addr;
+    return (size_t)(memsize-(hard_left_limit<0?hard_left_limit:0))*sizeof(int);
+}
 #endif
 
 /* -- */
@@ -142,18 +161,144 @@ restore_sigsegv(void)
 	perror("Restoring SIGSEGV handler, ignoring");
 }
 
+/*
+ * Page faults seen while the tape was mapped; -v reports them when the
+ * tape is unmapped along with how much of it ended up on huge pages.
+ */
+#if _POSIX_VERSION >= 200112L
+static struct rusage tape_rusage;
+#endif
+static int tape_is_hugetlb = 0;
+static unsigned long tape_prefaulted = 0;
+
+static void
+start_fault_count(void)
+{
+#if _POSIX_VERSION >= 200112L
+    getrusage(RUSAGE_SELF, &tape_rusage);
+#endif
+}
+
+static void
+report_fault_count(void)
+{
+#if _POSIX_VERSION >= 200112L
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+	fprintf(stderr, "Tape page faults %ld minor, %ld major",
+		ru.ru_minflt - tape_rusage.ru_minflt,
+		ru.ru_majflt - tape_rusage.ru_majflt);
+    else
+#endif
+	fprintf(stderr, "Tape mapped");
+    if (tape_prefaulted)
+	fprintf(stderr, ", %lukB prefaulted", (tape_prefaulted+1023)/1024);
+
+    if (tape_is_hugetlb)
+	fprintf(stderr, ", hugetlb pages");
+#ifdef __linux__
+    else {
+	/* Find our mapping in smaps to see if THP actually happened. */
+	FILE * fd = fopen("/proc/self/smaps", "r");
+	char line[256];
+	int found = 0;
+	unsigned long lo, hi, kb;
+
+	while (fd && fgets(line, sizeof(line), fd)) {
+	    if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2)
+		found = (lo <= (unsigned long)cell_array_pointer &&
+			 hi > (unsigned long)cell_array_pointer);
+	    else if (found && sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+		fprintf(stderr, ", %lukB on huge pages", kb);
+		break;
+	    }
+	}
+	if (fd) fclose(fd);
+    }
+#endif
+    fprintf(stderr, "\n");
+}
+
+/*
+ * How much of the tape to fault in before the run. If there are no
+ * T_MOV nodes the optimiser has proven the range, otherwise use the
+ * range a previous run of the profiling interpreter saw, or the -mem
+ * size. The cell width is the largest any runner will use.
+ */
+static void
+prefault_tape(char * tape, char * tape_end)
+{
+    long lo = 0, hi = memsize;
+    size_t cellbytes = sizeof(int);
+    char * p, * e;
+
+    if (cell_length > sizeof(int)*CHAR_BIT)
+	for(cellbytes = 8; cellbytes*CHAR_BIT < cell_length; cellbytes *= 2);
+
+    if (node_type_counts[T_MOV] == 0) {
+	lo = min_pointer; hi = max_pointer+1;
+    } else if (profile_min_cell != 0 || profile_max_cell != 0) {
+	lo = profile_min_cell; hi = profile_max_cell+1;
+    }
+
+    p = tape + lo * (long)cellbytes;
+    e = tape + hi * (long)cellbytes;
+    if (p < cell_array_low_addr) p = cell_array_low_addr;
+    if (e > tape_end) e = tape_end;
+    if (p >= e) return;
+
+    tape_prefaulted = e-p;
+#ifdef MADV_POPULATE_WRITE
+    {
+	char * pg = p - ((size_t)p & 4095);
+	if (madvise(pg, e-pg, MADV_POPULATE_WRITE) == 0)
+	    return;
+    }
+#endif
+    /* Writing a zero makes the kernel give us a real page. */
+    for(; p<e; p += 4096)
+	*(volatile char *)p = 0;
+    *(volatile char *)(e-1) = 0;
+}
+
 int huge_ram_available = 1;
 
 void *
 map_hugeram(void)
 {
-    char * mp;
-    unsigned long tapelength = MEMSIZE;
+    char * mp = MAP_FAILED;
+    size_t tapelength = MEMSIZE, wantedlength;
 
     if (cell_array_pointer != 0)
 	return cell_array_pointer;
 
-    for(;;) {
+    /* Whole huge pages so the guard regions stay aligned. */
+    if (tape_mem_size)
+	tapelength = (tape_mem_size + HUGESIZE-1) & ~(size_t)(HUGESIZE-1);
+    wantedlength = tapelength;
+
+#ifdef MAP_HUGETLB
+    /*
+     * Explicit huge pages have to be reserved by the admin, so the whole
+     * tape is allocated without MAP_NORESERVE and if that fails normal
+     * pages are used. The length must be a multiple of the page size.
+     */
+    if (opt_hugepage > 1) {
+	cell_array_alloc_len = tapelength + 2*MEMGUARD;
+	if (hard_left_limit<0)
+	    cell_array_alloc_len += HUGESIZE;
+	mp = mmap(0, cell_array_alloc_len,
+		    PROT_READ+PROT_WRITE,
+		    MAP_PRIVATE+MAP_ANONYMOUS+MAP_HUGETLB, -1, 0);
+	if (mp == MAP_FAILED) {
+	    if (verbose)
+		perror("Huge page mmap() of tape failed, using normal pages");
+	} else
+	    tape_is_hugetlb = 1;
+    }
+#endif
+
+    while(mp == MAP_FAILED) {
 	cell_array_alloc_len = tapelength + 2*MEMGUARD;
 	if (hard_left_limit<0)
 	    cell_array_alloc_len += MEMSKIP;
@@ -184,19 +329,34 @@ map_hugeram(void)
 	tapelength /= 2;
     }
 
-    if (cell_array_alloc_len < MEMSIZE)
-	if (verbose)
+    if (tapelength < wantedlength)
+	if (verbose || tape_mem_size)
 	    fprintf(stderr,
 		    "Warning: Only able to map %luMB of cell array, continuing.\n",
-		    tapelength / (1024*1024));
+		    (unsigned long)(tapelength / (1024*1024)));
 
     cell_array_low_addr = mp;
 
+    /* Note: madvise() takes one advice value at a time. */
+#ifdef MADV_HUGEPAGE
+    if (opt_hugepage && !tape_is_hugetlb) {
+	if( madvise(mp, cell_array_alloc_len, MADV_HUGEPAGE) )
+	    if (verbose)
+		perror("madvise(MADV_HUGEPAGE) on tape returned error");
+    } else
+#endif
+    if (!tape_is_hugetlb) {
 #ifdef MADV_MERGEABLE
-    if( madvise(mp, cell_array_alloc_len, MADV_MERGEABLE | MADV_SEQUENTIAL) )
-	if (verbose)
-	    perror("madvise() on tape returned error");
+	if( madvise(mp, cell_array_alloc_len, MADV_MERGEABLE) )
+	    if (verbose>1)
+		perror("madvise(MADV_MERGEABLE) on tape returned error");
 #endif
+#ifdef MADV_SEQUENTIAL
+	if( madvise(mp, cell_array_alloc_len, MADV_SEQUENTIAL) )
+	    if (verbose>1)
+		perror("madvise(MADV_SEQUENTIAL) on tape returned error");
+#endif
+    }
 
     if (MEMGUARD > 0 && cell_array_alloc_len >= 2*MEMGUARD) {
 	/*
@@ -214,19 +374,41 @@ map_hugeram(void)
 
     cell_array_pointer = mp;
     if (hard_left_limit<0)
-	cell_array_pointer += MEMSKIP;
+	cell_array_pointer += tape_is_hugetlb?HUGESIZE:MEMSKIP;
+
+    if (opt_prefault)
+	prefault_tape(cell_array_pointer,
+	    cell_array_low_addr + cell_array_alloc_len -
+		(cell_array_alloc_len >= 2*MEMGUARD?MEMGUARD:0));
+
+    if (verbose) start_fault_count();
 
     return cell_array_pointer;
 }
 
+/* The part of the tape between the guard regions, for -fwatchdog. */
+size_t
+tape_span(char ** lo)
+{
+    *lo = cell_array_low_addr;
+    if (MEMGUARD > 0 && cell_array_alloc_len >= 2*MEMGUARD) {
+	*lo += MEMGUARD;
+	return cell_array_alloc_len - 2*MEMGUARD;
+    }
+    return cell_array_alloc_len;
+}
+
 void
 unmap_hugeram(void)
 {
     if(cell_array_pointer==0) return;
+    if (verbose) report_fault_count();
     if(munmap(cell_array_low_addr, cell_array_alloc_len))
 	perror("munmap tape");
     cell_array_pointer = 0;
     cell_array_low_addr = 0;
+    tape_is_hugetlb = 0;
+    tape_prefaulted = 0;
 
     restore_sigsegv();
 }
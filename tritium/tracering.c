@@ -0,0 +1,274 @@
+/*
+ * Binary tracing for -trace-file.
+ *
+ * Rather than printing two lines of text for every node run the tree and
+ * array interpreters put a sixteen byte record into a ring in a memory
+ * mapped file. The kernel owns the pages so the records are still there
+ * if the program crashes or is killed; a long run can be traced and the
+ * last few million steps before a failure looked at afterwards.
+ *
+ * The file is a header, a copy of the fields of each node that -T prints
+ * and the ring. The header's head is the number of records written so
+ * far. The -trace-decode option reads the file and prints the records in
+ * the same format as -T.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#if defined(_POSIX_MAPPED_FILES) && ((_POSIX_MAPPED_FILES -0) > 0)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "bfi.tree.h"
+#include "bfi.run.h"
+#include "tracering.h"
+
+#if defined(MAP_SHARED) && !defined(DISABLE_TRACERING)
+#define USE_TRACERING
+#endif
+
+#define TRACE_MAGIC	"BFTRACE1"
+
+struct trace_hdr {
+    char magic[8];
+    int engine;			/* 0 is the tree, 1 the array interpreter */
+    int cell_bits;
+    int cell_mask;
+    int nodes;
+    unsigned long long records;	/* Size of the ring, a power of two */
+    unsigned long long head;	/* Records written */
+};
+
+struct trace_node {
+    int inum, type, line, col, jmp;
+    int count, offset, count2, offset2, count3, offset3, spare;
+};
+
+struct trace_rec * trace_ring = 0;
+unsigned long long * trace_head = 0, trace_mask = 0;
+
+#ifdef USE_TRACERING
+static void * trace_map = 0;
+static size_t trace_len = 0;
+
+int
+trace_open(const char * fname, unsigned long records, int engine)
+{
+    struct trace_hdr * h;
+    struct trace_node * t;
+    struct bfi * n;
+    unsigned long long size = 1;
+    int fd, nodes = 0;
+    size_t tlen;
+
+    for(n=bfprog; n; n=n->next) nodes++;
+    while (size < records) size *= 2;
+
+    tlen = sizeof(*h) + nodes * sizeof(*t);
+    trace_len = tlen + (size_t)size * sizeof(*trace_ring);
+
+    if ((fd = open(fname, O_RDWR|O_CREAT|O_TRUNC, 0666)) < 0) {
+	perror(fname);
+	return 0;
+    }
+    if (ftruncate(fd, (off_t)trace_len) < 0) {
+	perror(fname);
+	close(fd);
+	return 0;
+    }
+    trace_map = mmap(0, trace_len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (trace_map == MAP_FAILED) {
+	perror(fname);
+	trace_map = 0;
+	return 0;
+    }
+
+    h = trace_map;
+    memcpy(h->magic, TRACE_MAGIC, sizeof(h->magic));
+    h->engine = engine;
+    h->cell_bits = (int)cell_length;
+    h->cell_mask = cell_mask;
+    h->nodes = nodes;
+    h->records = size;
+    h->head = 0;
+
+    t = (struct trace_node *)(h+1);
+    for(n=bfprog; n; n=n->next, t++) {
+	t->inum = n->inum;
+	t->type = n->type;
+	t->line = n->line;
+	t->col = n->col;
+	t->jmp = n->jmp ? n->jmp->inum : -1;
+	t->count = n->count; t->offset = n->offset;
+	t->count2 = n->count2; t->offset2 = n->offset2;
+	t->count3 = n->count3; t->offset3 = n->offset3;
+    }
+
+    trace_ring = (struct trace_rec *)((char*)trace_map + tlen);
+    trace_head = &h->head;
+    trace_mask = size-1;
+    return 1;
+}
+
+void
+trace_close(void)
+{
+    if (!trace_map) return;
+    munmap(trace_map, trace_len);
+    trace_map = 0;
+    trace_ring = 0;
+    trace_head = 0;
+}
+
+/*
+ * Print the records in the ring the same way as run_tree() does for -T.
+ * The array interpreter has no T_MOV nodes and the rail searches are not
+ * used while tracing so every op is a node and the second line shows the
+ * same cell as the first.
+ */
+int
+trace_decode(const char * fname)
+{
+    struct stat st;
+    struct trace_hdr * h;
+    struct trace_node * t;
+    struct trace_rec * ring, * r, r2;
+    struct bfi * nodes, ** byinum, *n, *n2;
+    unsigned long long i, first, mask;
+    int fd, j, maxinum = 0;
+    size_t tlen;
+    void * map;
+
+    if ((fd = open(fname, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+	perror(fname);
+	return 1;
+    }
+    map = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED || (size_t)st.st_size < sizeof(*h)) {
+	fprintf(stderr, "%s: not a binary trace file\n", fname);
+	return 1;
+    }
+    h = map;
+    tlen = sizeof(*h) + (size_t)h->nodes * sizeof(*t);
+    if (memcmp(h->magic, TRACE_MAGIC, sizeof(h->magic)) != 0 ||
+	    h->nodes < 0 || h->records == 0 || (h->records & (h->records-1)) ||
+	    (size_t)st.st_size < tlen + (size_t)h->records * sizeof(*ring)) {
+	fprintf(stderr, "%s: not a binary trace file\n", fname);
+	munmap(map, (size_t)st.st_size);
+	return 1;
+    }
+    t = (struct trace_node *)(h+1);
+    ring = (struct trace_rec *)((char*)map + tlen);
+    mask = h->records-1;
+
+    nodes = tcalloc((size_t)h->nodes+1, sizeof(*nodes));
+    for(j=0; j<h->nodes; j++) {
+	n = nodes+j;
+	n->inum = t[j].inum; n->type = t[j].type;
+	n->line = t[j].line; n->col = t[j].col;
+	n->count = t[j].count; n->offset = t[j].offset;
+	n->count2 = t[j].count2; n->offset2 = t[j].offset2;
+	n->count3 = t[j].count3; n->offset3 = t[j].offset3;
+	if (n->inum > maxinum) maxinum = n->inum;
+    }
+    byinum = tcalloc((size_t)maxinum+1, sizeof(*byinum));
+    for(j=0; j<h->nodes; j++)
+	if (nodes[j].inum >= 0) byinum[nodes[j].inum] = nodes+j;
+    /* The spare node is for a loop with a missing end. */
+    for(j=0; j<h->nodes; j++)
+	if (t[j].jmp >= 0)
+	    nodes[j].jmp = (t[j].jmp <= maxinum && byinum[t[j].jmp])
+		? byinum[t[j].jmp] : nodes+h->nodes;
+
+    /* The profile counts are rebuilt so they're from the first record. */
+    first = h->head > h->records ? h->head - h->records : 0;
+    if (first > 0)
+	printf("Skipped %llu records, counts are from here.\n", first);
+
+    for(i=first; i<h->head; i++) {
+	int off, p;
+	r = ring + (i & mask);
+	if (r->node < 0 || r->node > maxinum || (n = byinum[r->node]) == 0)
+	    continue;
+
+	n->profile++;
+	off = r->off;
+	p = off - n->offset;
+	r2.val = r2.nval = 0;
+	if (n->type == T_CALC && i+1 < h->head &&
+		ring[(i+1) & mask].node == TRACE_MORE)
+	    r2 = ring[++i & mask];
+
+	printf("P(%d,%d)=", n->line, n->col);
+	printtreecell(stdout, -1, n);
+	if (n->type == T_MOV)
+	    printf("\n");
+	else if (n->type != T_CALC) {
+	    if (off >= 0)
+		printf("mem[%d]=%d\n", off, r->val);
+	    else
+		printf("mem[%d]= UNDERFLOW\n", off);
+	} else {
+	    int off2 = p + n->offset2, off3 = p + n->offset3;
+	    if (n->offset == n->offset2 && n->count2 == 1) {
+		if (n->count3 != 0 && r2.nval == 0)
+		    printf("mem[%d]=%d, BF Skip.\n", off3, r2.nval);
+		else {
+		    printf("mem[%d]=%d", off, r->val);
+		    if (n->count3 != 0)
+			printf(", mem[%d]=%d", off3, r2.nval);
+		    printf(off < 0 ? " UNDERFLOW\n" : "\n");
+		}
+	    } else {
+		printf("mem[%d]=%d", off, r->val);
+		if (n->count2 != 0)
+		    printf(", mem[%d]=%d", off2, r2.val);
+		if (n->count3 != 0)
+		    printf(", mem[%d]=%d", off3, r2.nval);
+		printf("\n");
+	    }
+	}
+
+	/* The tree interpreter prints the node it jumped to. */
+	n2 = n;
+	if (h->engine == 0) {
+	    switch(n->type) {
+	    case T_WHL: case T_IF: case T_MULT: case T_CMULT:
+		if ((r->val & h->cell_mask) == 0) n2 = n->jmp;
+		break;
+	    case T_END:
+		if ((r->val & h->cell_mask) != 0) n2 = n->jmp;
+		break;
+	    case T_MOV:
+		p += n->count;
+		break;
+	    }
+	    off = p + n2->offset;
+	}
+	if (n2->type == T_PRT || n2->type == T_CHR || n2->type == T_ENDIF)
+	    continue;
+	printf("P(%d,%d):mem[%d]=%d\n", n2->line, n2->col, off, r->nval);
+    }
+
+    free(byinum);
+    free(nodes);
+    munmap(map, (size_t)st.st_size);
+    return 0;
+}
+
+#else
+int trace_open(const char * fname, unsigned long records, int engine)
+{ (void)fname; (void)records; (void)engine; return 0; }
+void trace_close(void) { }
+int trace_decode(const char * fname)
+{
+    fprintf(stderr, "%s: binary traces are not available\n", fname);
+    return 1;
+}
+#endif
@@ -0,0 +1,22 @@
+
+/*
+ * A -trace-file record; node is the inum of the node executed and off the
+ * tape cell it used. The value of the cell before the node runs is in val
+ * and the value -T would print after it runs is in nval.
+ */
+struct trace_rec { int node, off, val, nval; };
+
+#define TRACE_MORE	-1	/* Follows a T_CALC; the cells at off2 and off3 */
+
+extern struct trace_rec * trace_ring;
+extern unsigned long long * trace_head, trace_mask;
+
+/* Write a record to the ring, r is left pointing at it. */
+#define TRACE_PUT(r,n,o,v) ( \
+	(r) = trace_ring + (*trace_head & trace_mask), \
+	(r)->node = (n), (r)->off = (o), (r)->val = (r)->nval = (v), \
+	++*trace_head)
+
+int trace_open(const char * fname, unsigned long records, int engine);
+void trace_close(void);
+int trace_decode(const char * fname);
@@ -0,0 +1,240 @@
+/*
+ * The -fwatchdog, --loop-limit and --time-limit checks. The engines that
+ * have them count watchdog_count down at every loop back-edge, the T_END,
+ * and call watchdog_tick() when it goes negative; when none of the options
+ * are given the engines leave the count out so it costs nothing.
+ *
+ * Each tick adds the back-edges since the last one to the total for the
+ * loop limit and reads the clock for the time limit.
+ *
+ * For -fwatchdog the loop, the pointer and the tape at a tick are compared
+ * with a snapshot taken at an earlier tick; if they are the same and there
+ * has been no I/O between them the program will go round the same states
+ * forever. The snapshot is retaken when the ticks since the last one reach
+ * a power of two (Brent's method) so any cycle is found within a few times
+ * its length. Only the tape pages the kernel has handed out are copied,
+ * the rest are still zero, and the tape is only compared when the loop and
+ * the pointer are the same as in the snapshot. If the checks take more
+ * than 1% of the run time some ticks are skipped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#define USE_MINCORE
+#endif
+
+#include "bfi.tree.h"
+#include "bfi.run.h"
+#include "clock.h"
+#include "watchdog.h"
+
+int opt_watchdog = 0;
+unsigned long watchdog_interval = 1UL<<20;
+unsigned long long loop_limit = 0;
+double time_limit = 0;
+int watchdog_count = INT_MAX;
+
+static unsigned long long edges;	/* Back-edges to the last tick */
+static unsigned long chunk;		/* Back-edges to the next tick */
+static double start_time;
+
+static char * tape_lo;
+static size_t tape_len, page_size, npages;
+static unsigned char * cur_pages;
+
+static double spent;			/* In the cycle checks */
+
+static struct {
+    int valid;
+    const struct wd_loop * loop;
+    char * cellp;
+    unsigned long long io;
+    unsigned long long edges;
+    unsigned long ticks, power;
+    unsigned char * pages;		/* From mincore() */
+    size_t * list, nlist;		/* The pages that are copied */
+    char * data;
+} snap;
+
+int
+watchdog_on(void)
+{
+    return opt_watchdog || loop_limit || time_limit > 0;
+}
+
+void
+watchdog_missing(const char * engine)
+{
+    if (watchdog_on())
+	fprintf(stderr, "Warning: The '%s' engine has no watchdog, "
+			"the loop checks are not done.\n", engine);
+}
+
+static void
+next_chunk(void)
+{
+    chunk = watchdog_interval ? watchdog_interval : 1;
+    if (chunk > INT_MAX) chunk = INT_MAX;
+    if (loop_limit && loop_limit - edges < chunk)
+	chunk = (unsigned long)(loop_limit - edges) + 1;
+    watchdog_count = (int)chunk - 1;
+}
+
+/* Which pages of the tape are in use; all of them without mincore(). */
+static void
+map_pages(unsigned char * v)
+{
+    size_t i;
+#ifdef USE_MINCORE
+    if (mincore(tape_lo, tape_len, v) == 0) {
+	for(i=0; i<npages; i++) v[i] &= 1;
+	return;
+    }
+#endif
+    for(i=0; i<npages; i++) v[i] = 1;
+}
+
+static size_t
+page_len(size_t i)
+{
+    size_t l = tape_len - i*page_size;
+    return l < page_size ? l : page_size;
+}
+
+static void
+take_snapshot(char * cellp, const struct wd_loop * loop,
+	unsigned long long io)
+{
+    size_t i;
+    char * d;
+
+    map_pages(snap.pages);
+    for(snap.nlist=0, i=0; i<npages; i++)
+	if (snap.pages[i]) snap.list[snap.nlist++] = i;
+    free(snap.data);
+    snap.data = d = tcalloc(snap.nlist+1, page_size);
+    for(i=0; i<snap.nlist; i++) {
+	memcpy(d, tape_lo+snap.list[i]*page_size, page_len(snap.list[i]));
+	d += page_size;
+    }
+
+    snap.valid = 1;
+    snap.loop = loop;
+    snap.cellp = cellp;
+    snap.io = io;
+    snap.edges = edges;
+    snap.ticks = 0;
+}
+
+/*
+ * The copied pages are compared first as they normally differ; any page
+ * the kernel has handed out since the snapshot must still be all zero.
+ */
+static int
+same_tape(void)
+{
+    size_t i;
+    char * p;
+
+    for(i=0; i<snap.nlist; i++)
+	if (memcmp(snap.data+i*page_size, tape_lo+snap.list[i]*page_size,
+		page_len(snap.list[i])) != 0)
+	    return 0;
+
+    map_pages(cur_pages);
+    for(i=0; i<npages; i++)
+	if (cur_pages[i] && !snap.pages[i]) {
+	    p = tape_lo+i*page_size;
+	    if (p[0] || memcmp(p, p+1, page_len(i)-1) != 0)
+		return 0;
+	}
+    return 1;
+}
+
+void
+watchdog_start(void)
+{
+    start_time = wall_clock();
+    edges = 0;
+    spent = 0;
+    snap.valid = 0;
+    next_chunk();
+    if (!opt_watchdog || cur_pages) return;
+
+    page_size = (size_t)sysconf(_SC_PAGESIZE);
+    if (page_size == 0 || page_size == (size_t)-1) page_size = 4096;
+    tape_len = tape_span(&tape_lo);
+    npages = (tape_len + page_size - 1) / page_size;
+    cur_pages = tcalloc(npages, 2);
+    snap.pages = cur_pages + npages;
+    snap.list = tcalloc(npages, sizeof*snap.list);
+
+#ifdef USE_MINCORE
+    if (mincore(tape_lo, tape_len, cur_pages) == 0) return;
+#endif
+    /* Copying a huge tape at every snapshot would take forever. */
+    if (tape_len > 64UL*1024*1024) {
+	if (verbose)
+	    fprintf(stderr, "The tape is too large for the -fwatchdog "
+			    "cycle check; only the limits are checked.\n");
+	opt_watchdog = 0;
+    }
+}
+
+static void
+watchdog_stop(const struct wd_loop * loop, const char * why)
+{
+    fflush(stdout);
+    fprintf(stderr, "Error: %s in the loop at %d:%d\n",
+	    why, loop->line, loop->col);
+    exit(1);
+}
+
+void
+watchdog_tick(char * cellp, const struct wd_loop * loop)
+{
+    unsigned long long io;
+    double now = 0;
+    char buf[96];
+
+    edges += chunk;
+    next_chunk();
+
+    if (loop_limit && edges > loop_limit) {
+	sprintf(buf, "Loop limit of %llu back-edges reached", loop_limit);
+	watchdog_stop(loop, buf);
+    }
+    if (time_limit > 0 || opt_watchdog)
+	now = wall_clock();
+    if (time_limit > 0 && now - start_time > time_limit) {
+	sprintf(buf, "Time limit of %gs reached", time_limit);
+	watchdog_stop(loop, buf);
+    }
+    if (!opt_watchdog) return;
+
+    /* The cycle checks are skipped while they use over 1% of the time. */
+    if (spent > (now - start_time) / 100) return;
+
+    io = (unsigned long long)(output_bytes + input_chars);
+    if (!snap.valid || snap.io != io) {
+	take_snapshot(cellp, loop, io);
+	snap.power = 1;
+    } else {
+	if (snap.loop == loop && snap.cellp == cellp && same_tape()) {
+	    sprintf(buf, "Infinite loop; the tape is the same as it was "
+			 "%llu back-edges ago", edges - snap.edges);
+	    watchdog_stop(loop, buf);
+	}
+
+	if (++snap.ticks >= snap.power) {
+	    take_snapshot(cellp, loop, io);
+	    snap.power *= 2;
+	}
+    }
+    spent += wall_clock() - now;
+}
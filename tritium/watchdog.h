@@ -0,0 +1,14 @@
+
+/* The loop a watchdog tick is at; the position of its '[' */
+struct wd_loop { int line, col; };
+
+extern int opt_watchdog;
+extern unsigned long watchdog_interval;
+extern unsigned long long loop_limit;
+extern double time_limit;
+extern int watchdog_count;
+
+int watchdog_on(void);
+void watchdog_start(void);
+void watchdog_missing(const char * engine);
+void watchdog_tick(char * cellp, const struct wd_loop * loop);